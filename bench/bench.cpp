@@ -0,0 +1,497 @@
+#include "tessellation/Painter.h"
+
+#include <primitive/Path.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Times each Add* call of the painter over its modes and input sizes, one line per case:
+//     tess_bench [filter] [--min-time=seconds] [--uint32] [--csv]
+// filter keeps the cases with it in their name.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs(0);
+
+}
+
+// every heap allocation, PodArray's malloc() included where the C library lets us wrap it
+#ifdef __GLIBC__
+extern "C"
+{
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+}
+#else
+void* operator new(size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+#endif // __GLIBC__
+
+namespace
+{
+
+using namespace tess;
+
+const uint32_t COL = 0xff3080ff;
+
+const float THIN  = 1.0f;
+const float THICK = 3.0f;
+
+const size_t SIZES[] = { 2, 10, 100, 1000, 10000, 100000, 1000000 };
+
+// Add* calls per iteration for the small shapes, so the clock sees more than a few ns
+const size_t BATCH = 1000;
+
+struct Mode
+{
+	const char* name;
+	uint32_t    flags;
+};
+
+const Mode STROKE_MODES[] = {
+	{ "noaa", 0 },
+	{ "aa", ANTI_ALIASED_LINES | ANTI_ALIASED_FILL },
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	{ "analytic", ANTI_ALIASED_LINES | ANTI_ALIASED_FILL | ANALYTIC_AA },
+#endif
+};
+
+struct Case
+{
+	std::string name;
+	uint32_t    flags;
+	size_t      calls;	// Add* calls per iteration
+	std::function<void(Painter&)> draw;
+};
+
+struct Options
+{
+	std::string filter;
+	double      min_time = 0.1;
+	IndexType   index_type = IndexType::UInt16;
+	bool        csv = false;
+};
+
+struct Result
+{
+	double ns_per_iter = 0;
+	size_t vtx_count = 0, idx_count = 0;	// per iteration
+	size_t cold_allocs = 0;					// the first iteration, on a new painter
+	double warm_allocs = 0;					// per iteration after it
+};
+
+size_t alloc_count()
+{
+	return g_allocs.load(std::memory_order_relaxed);
+}
+
+// a wavy line across a 1920 x 1080 screen
+std::vector<sm::vec2> make_polyline(size_t count)
+{
+	std::vector<sm::vec2> pts(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float t = count > 1 ? static_cast<float>(i) / (count - 1) : 0;
+		pts[i] = sm::vec2(20 + t * 1880, 540 + 400 * std::sin(t * 40) + 50 * std::sin(i * 0.7f));
+	}
+	return pts;
+}
+
+std::vector<sm::vec2> make_convex(size_t count)
+{
+	std::vector<sm::vec2> pts(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float a = 2 * SM_PI * i / count;
+		pts[i] = sm::vec2(960 + 500 * std::cos(a), 540 + 500 * std::sin(a));
+	}
+	return pts;
+}
+
+// the wavy line and its copy 40 pixels lower, as an area chart: concave with a few
+// edges on each row, where a star would put O(n) of them in the triangulator's sweep
+std::vector<sm::vec2> make_band(size_t count)
+{
+	const size_t half = std::max<size_t>(count / 2, 2);
+	auto pts = make_polyline(half);
+	for (size_t i = half; i > 0; --i) {
+		pts.push_back(pts[i - 1] + sm::vec2(0, 40));
+	}
+	return pts;
+}
+
+std::string size_name(size_t n)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "n=%zu", n);
+	return buf;
+}
+
+std::string width_name(float w)
+{
+	return w == THIN ? "thin" : "thick";
+}
+
+void add_shape_cases(std::vector<Case>& cases)
+{
+	auto pos = [](size_t i) {
+		return sm::vec2(10.0f + (i * 37) % 1900, 10.0f + (i * 53) % 1060);
+	};
+
+	for (auto& mode : STROKE_MODES)
+	{
+		for (float w : { THIN, THICK })
+		{
+			const std::string suffix = std::string("/") + mode.name + "/" + width_name(w);
+			cases.push_back({ "AddLine" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddLine(pos(i), pos(i + 1), COL, w);
+				}
+			} });
+			cases.push_back({ "AddDashLine" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddDashLine(pos(i), pos(i) + sm::vec2(100, 30), COL, w, 4);
+				}
+			} });
+			cases.push_back({ "AddRect" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddRect(pos(i), pos(i) + sm::vec2(40, 20), COL, w);
+				}
+			} });
+			cases.push_back({ "AddRect/rounded" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddRect(pos(i), pos(i) + sm::vec2(40, 20), COL, w, 6, CORNER_FLAGS_ALL);
+				}
+			} });
+			cases.push_back({ "AddTriangle" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddTriangle(pos(i), pos(i) + sm::vec2(30, 0), pos(i) + sm::vec2(0, 30), COL, w);
+				}
+			} });
+			for (uint32_t segs : { 8u, 32u, 128u })
+			{
+				const std::string segs_name = "/segs=" + std::to_string(segs);
+				cases.push_back({ "AddCircle" + segs_name + suffix, mode.flags, BATCH, [=](Painter& pt) {
+					for (size_t i = 0; i < BATCH; ++i) {
+						pt.AddCircle(pos(i), 20, COL, w, segs);
+					}
+				} });
+				cases.push_back({ "AddArc" + segs_name + suffix, mode.flags, BATCH, [=](Painter& pt) {
+					for (size_t i = 0; i < BATCH; ++i) {
+						pt.AddArc(pos(i), 20, 0, SM_PI, COL, w, segs);
+					}
+				} });
+			}
+		}
+
+		const std::string suffix = std::string("/") + mode.name;
+		cases.push_back({ "AddRectFilled" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+			for (size_t i = 0; i < BATCH; ++i) {
+				pt.AddRectFilled(pos(i), pos(i) + sm::vec2(40, 20), COL);
+			}
+		} });
+		cases.push_back({ "AddRectFilled/rounded" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+			for (size_t i = 0; i < BATCH; ++i) {
+				pt.AddRectFilled(pos(i), pos(i) + sm::vec2(40, 20), COL, 6, CORNER_FLAGS_ALL);
+			}
+		} });
+		cases.push_back({ "AddTriangleFilled" + suffix, mode.flags, BATCH, [=](Painter& pt) {
+			for (size_t i = 0; i < BATCH; ++i) {
+				pt.AddTriangleFilled(pos(i), pos(i) + sm::vec2(30, 0), pos(i) + sm::vec2(0, 30), COL);
+			}
+		} });
+		for (uint32_t segs : { 8u, 32u, 128u })
+		{
+			cases.push_back({ "AddCircleFilled/segs=" + std::to_string(segs) + suffix, mode.flags, BATCH, [=](Painter& pt) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					pt.AddCircleFilled(pos(i), 20, COL, segs);
+				}
+			} });
+		}
+	}
+
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	cases.push_back({ "AddTexQuad", 0, BATCH, [=](Painter& pt) {
+		const std::array<sm::vec2, 4> uv = { sm::vec2(0, 0), sm::vec2(1, 0), sm::vec2(1, 1), sm::vec2(0, 1) };
+		for (size_t i = 0; i < BATCH; ++i)
+		{
+			const sm::vec2 p = pos(i);
+			pt.AddTexQuad(1, { p, p + sm::vec2(32, 0), p + sm::vec2(32, 32), p + sm::vec2(0, 32) }, uv, COL);
+		}
+	} });
+#endif
+}
+
+void add_polyline_cases(std::vector<Case>& cases)
+{
+	for (size_t n : SIZES)
+	{
+		auto line   = std::make_shared<std::vector<sm::vec2>>(make_polyline(n));
+		auto convex = std::make_shared<std::vector<sm::vec2>>(make_convex(std::max<size_t>(n, 3)));
+		auto band   = std::make_shared<std::vector<sm::vec2>>(make_band(n));
+		auto cols   = std::make_shared<std::vector<uint32_t>>(n);
+		for (size_t i = 0; i < n; ++i) {
+			(*cols)[i] = 0xff000000 | static_cast<uint32_t>(i * 2654435761u >> 8);
+		}
+
+		auto path = std::make_shared<prim::Path>();
+		path->MoveTo((*line)[0]);
+		for (size_t i = 1; i < n; ++i) {
+			path->LineTo((*line)[i]);
+		}
+
+		const std::string sz = "/" + size_name(n);
+		for (auto& mode : STROKE_MODES)
+		{
+			for (float w : { THIN, THICK })
+			{
+				const std::string suffix = sz + "/" + mode.name + "/" + width_name(w);
+				cases.push_back({ "AddPolyline" + suffix, mode.flags, 1, [=](Painter& pt) {
+					pt.AddPolyline(line->data(), line->size(), COL, w);
+				} });
+				cases.push_back({ "AddPolylineMultiColor" + suffix, mode.flags, 1, [=](Painter& pt) {
+					pt.AddPolylineMultiColor(line->data(), cols->data(), line->size(), w);
+				} });
+				cases.push_back({ "AddPolylineDash" + suffix, mode.flags, 1, [=](Painter& pt) {
+					const float pattern[] = { 8, 4, 2, 4 };
+					pt.AddPolylineDash(line->data(), line->size(), pattern, 4, 0, COL, w);
+				} });
+				cases.push_back({ "AddPolygon" + suffix, mode.flags, 1, [=](Painter& pt) {
+					pt.AddPolygon(convex->data(), convex->size(), COL, w);
+				} });
+				cases.push_back({ "AddPath" + suffix, mode.flags, 1, [=](Painter& pt) {
+					pt.AddPath(*path, COL, w);
+				} });
+				cases.push_back({ "AddPolyline3D" + suffix, mode.flags, 1, [=](Painter& pt) {
+					thread_local std::vector<sm::vec3> pts3;
+					pts3.resize(line->size());
+					for (size_t i = 0; i < line->size(); ++i) {
+						pts3[i] = sm::vec3((*line)[i].x, (*line)[i].y, 0);
+					}
+					pt.AddPolyline3D(pts3.data(), pts3.size(), [](const sm::vec3& p) { return sm::vec2(p.x, p.y); }, COL, w);
+				} });
+			}
+
+			const std::string suffix = sz + "/" + mode.name;
+			cases.push_back({ "AddPolygonFilled/convex" + suffix, mode.flags, 1, [=](Painter& pt) {
+				pt.AddPolygonFilled(convex->data(), convex->size(), COL);
+			} });
+			cases.push_back({ "AddPolygonFilled/concave" + suffix, mode.flags, 1, [=](Painter& pt) {
+				pt.AddPolygonFilled(band->data(), band->size(), COL);
+			} });
+		}
+	}
+}
+
+// 64 layers, as a frame with one painter per layer would have them
+void add_merge_cases(std::vector<Case>& cases, IndexType index_type)
+{
+	const size_t LAYERS = 64;
+	for (size_t shapes : { 10, 1000 })
+	{
+		auto layers = std::make_shared<std::vector<Painter>>();
+		auto ptrs   = std::make_shared<std::vector<const Painter*>>();
+		for (size_t l = 0; l < LAYERS; ++l)
+		{
+			layers->emplace_back(index_type);
+			auto& pt = layers->back();
+			for (size_t i = 0; i < shapes; ++i)
+			{
+				const sm::vec2 p(10.0f + (i * 37 + l) % 1900, 10.0f + (i * 53) % 1060);
+				pt.AddCircleFilled(p, 10, COL, 16);
+				pt.AddLine(p, p + sm::vec2(20, 5), COL, THICK);
+			}
+		}
+		for (auto& pt : *layers) {
+			ptrs->push_back(&pt);
+		}
+
+		const std::string sz = "/layers=64/shapes=" + std::to_string(shapes);
+		const uint32_t flags = ANTI_ALIASED_LINES | ANTI_ALIASED_FILL;
+		cases.push_back({ "AddPainter" + sz, flags, LAYERS, [=](Painter& pt) {
+			for (auto& src : *layers) {
+				pt.AddPainter(src);
+			}
+		} });
+		cases.push_back({ "MergePainters" + sz, flags, 1, [=](Painter& pt) {
+			pt.MergePainters(ptrs->data(), ptrs->size());
+		} });
+		cases.push_back({ "FillPainter" + sz, flags, LAYERS, [=](Painter& pt) {
+			size_t vtx = 0, idx = 0, cmd = 0;
+			for (auto& src : *layers)
+			{
+				auto& buf = src.GetBuffer();
+				vtx += buf.vertices.size();
+				idx += buf.IndexCount();
+				cmd += buf.commands.size();
+			}
+			pt.Resize(vtx, idx, cmd);
+			vtx = idx = cmd = 0;
+			for (auto& src : *layers)
+			{
+				auto& buf = src.GetBuffer();
+				pt.FillPainter(src, vtx, idx, cmd);
+				vtx += buf.vertices.size();
+				idx += buf.IndexCount();
+				cmd += buf.commands.size();
+			}
+		} });
+	}
+}
+
+Result run_case(const Case& c, const Options& opts)
+{
+	Result res;
+
+	Painter pt(opts.index_type);
+	pt.SetFlags(c.flags);
+
+	const size_t cold_begin = alloc_count();
+	c.draw(pt);
+	res.cold_allocs = alloc_count() - cold_begin;
+	res.vtx_count = pt.GetBuffer().vertices.size();
+	res.idx_count = pt.GetBuffer().IndexCount();
+
+	// doubles the iterations until one run takes min_time
+	for (size_t iters = 1; ; iters *= 2)
+	{
+		const size_t allocs_begin = alloc_count();
+		const auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iters; ++i)
+		{
+			pt.Clear();
+			c.draw(pt);
+		}
+		const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		if (secs >= opts.min_time || iters >= (size_t(1) << 30))
+		{
+			res.ns_per_iter = secs * 1e9 / iters;
+			res.warm_allocs = static_cast<double>(alloc_count() - allocs_begin) / iters;
+			break;
+		}
+	}
+
+	return res;
+}
+
+void print_header(const Options& opts)
+{
+	if (opts.csv) {
+		printf("name,calls,ns_per_call,vertices,indices,mvtx_per_sec,mb_per_sec,cold_allocs,allocs_per_iter\n");
+	} else {
+		printf("%-56s %8s %12s %10s %10s %10s %8s %10s\n",
+			"case", "calls", "ns/call", "vertices", "Mvtx/s", "MB/s", "allocs", "allocs/it");
+	}
+}
+
+void print_result(const Case& c, const Result& res, const Options& opts)
+{
+	const size_t idx_size = opts.index_type == IndexType::UInt32 ? sizeof(uint32_t) : sizeof(unsigned short);
+	const double bytes = static_cast<double>(res.vtx_count * sizeof(Painter::Vertex) + res.idx_count * idx_size);
+	const double secs = res.ns_per_iter * 1e-9;
+	const double mvtx = secs > 0 ? res.vtx_count / secs * 1e-6 : 0;
+	const double mb   = secs > 0 ? bytes / secs * 1e-6 : 0;
+	const double ns_per_call = res.ns_per_iter / c.calls;
+	if (opts.csv)
+	{
+		printf("%s,%zu,%.1f,%zu,%zu,%.2f,%.2f,%zu,%.2f\n", c.name.c_str(), c.calls, ns_per_call,
+			res.vtx_count, res.idx_count, mvtx, mb, res.cold_allocs, res.warm_allocs);
+	}
+	else
+	{
+		printf("%-56s %8zu %12.1f %10zu %10.2f %10.1f %8zu %10.2f\n", c.name.c_str(), c.calls, ns_per_call,
+			res.vtx_count, mvtx, mb, res.cold_allocs, res.warm_allocs);
+	}
+	fflush(stdout);
+}
+
+bool parse_options(int argc, char* argv[], Options& opts)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (std::strncmp(arg, "--min-time=", 11) == 0) {
+			opts.min_time = std::atof(arg + 11);
+		} else if (std::strcmp(arg, "--uint32") == 0) {
+			opts.index_type = IndexType::UInt32;
+		} else if (std::strcmp(arg, "--csv") == 0) {
+			opts.csv = true;
+		} else if (arg[0] == '-') {
+			fprintf(stderr, "usage: %s [filter] [--min-time=seconds] [--uint32] [--csv]\n", argv[0]);
+			return false;
+		} else {
+			opts.filter = arg;
+		}
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opts;
+	if (!parse_options(argc, argv, opts)) {
+		return 1;
+	}
+
+	std::vector<Case> cases;
+	add_shape_cases(cases);
+	add_polyline_cases(cases);
+	add_merge_cases(cases, opts.index_type);
+
+	print_header(opts);
+	for (auto& c : cases)
+	{
+		if (!opts.filter.empty() && c.name.find(opts.filter) == std::string::npos) {
+			continue;
+		}
+		print_result(c, run_case(c, opts), opts);
+	}
+
+	return 0;
+}
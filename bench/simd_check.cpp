@@ -0,0 +1,319 @@
+#include "tessellation/Painter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Checks the SIMD stroke and fill normals against the scalar kernels of a TESS_NO_SIMD build:
+//     tess_simd_check_scalar --write ref.bin
+//     tess_simd_check --compare ref.bin
+// Both run the same long polylines and fills through the painter, the positions have to agree
+// within TOLERANCE and everything else exactly. Each build also strokes one polyline from
+// several start points, which moves its points between the SIMD loops and their scalar tails.
+
+namespace
+{
+
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS16_COL
+// one step of the fixed point positions, where a last bit can round either way
+const float TOLERANCE = 1e-3f + 1.0f / TESS_VERTEX_POS16_SCALE;
+#else
+const float TOLERANCE = 1e-3f;
+#endif // TESS_VERTEX_LAYOUT
+
+struct Output
+{
+	std::string           name;
+	std::vector<float>    positions;	// x, y of each vertex
+	std::vector<uint32_t> cols;
+	std::vector<uint32_t> indices;
+};
+
+// random walk with sharp turns, repeated points and runs of straight segments
+std::vector<sm::vec2> make_polyline(size_t count, unsigned seed)
+{
+	srand(seed);
+	std::vector<sm::vec2> points;
+	points.reserve(count);
+	sm::vec2 p(500, 500);
+	float angle = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		points.push_back(p);
+		switch (rand() % 8)
+		{
+		case 0:
+			break;
+		case 1:
+			angle += 2.5f;
+			break;
+		default:
+			angle += (rand() % 200 - 100) * 0.004f;
+			break;
+		}
+		const float len = (rand() % 100) * 0.05f;
+		p += sm::vec2(std::cos(angle) * len, std::sin(angle) * len);
+	}
+	return points;
+}
+
+std::vector<sm::vec2> make_convex(size_t count, float radius, bool reversed)
+{
+	std::vector<sm::vec2> points(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float a = (reversed ? -1.0f : 1.0f) * i * 6.2831853f / count;
+		points[i] = sm::vec2(500 + std::cos(a) * radius, 400 + std::sin(a) * radius * 0.5f);
+	}
+	return points;
+}
+
+Output read_painter(const std::string& name, const tess::Painter& pt)
+{
+	Output out;
+	out.name = name;
+	auto& buf = pt.GetBuffer();
+	for (auto& v : buf.vertices)
+	{
+		const sm::vec2 pos = v.GetPos();
+		out.positions.push_back(pos.x);
+		out.positions.push_back(pos.y);
+		out.cols.push_back(v.col);
+	}
+	out.indices.assign(buf.indices32.begin(), buf.indices32.end());
+	return out;
+}
+
+std::vector<Output> run_cases()
+{
+	struct Mode
+	{
+		const char* name;
+		uint32_t    flags;
+	};
+	const Mode modes[] = {
+		{ "noaa", 0 },
+		{ "aa", tess::ANTI_ALIASED_LINES | tess::ANTI_ALIASED_FILL },
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+		{ "analytic", tess::ANTI_ALIASED_LINES | tess::ANTI_ALIASED_FILL | tess::ANALYTIC_AA },
+#endif // TESS_VERTEX_LAYOUT
+	};
+
+	const auto polyline = make_polyline(10007, 1);
+	std::vector<uint32_t> cols(polyline.size());
+	for (size_t i = 0; i < cols.size(); ++i) {
+		cols[i] = 0xff000000 | static_cast<uint32_t>(i * 2654435761u >> 8);
+	}
+	const auto convex    = make_convex(5003, 300, false);
+	const auto convex_cw = make_convex(4099, 200, true);
+
+	std::vector<Output> outputs;
+	for (auto& mode : modes)
+	{
+		auto run = [&](const char* name, const std::function<void(tess::Painter&)>& draw)
+		{
+			tess::Painter pt(tess::IndexType::UInt32);
+			pt.SetFlags(mode.flags);
+			draw(pt);
+			outputs.push_back(read_painter(std::string(mode.name) + "/" + name, pt));
+		};
+
+		run("polyline_thin", [&](tess::Painter& pt) {
+			pt.AddPolyline(polyline.data(), polyline.size(), 0xff00ff00, 1.0f);
+		});
+		run("polyline_thick", [&](tess::Painter& pt) {
+			pt.AddPolyline(polyline.data(), polyline.size(), 0xff00ff00, 3.5f);
+		});
+		run("polyline_multicolor", [&](tess::Painter& pt) {
+			pt.AddPolylineMultiColor(polyline.data(), cols.data(), polyline.size(), 2.0f);
+		});
+		run("polygon", [&](tess::Painter& pt) {
+			pt.AddPolygon(polyline.data(), polyline.size(), 0xff0000ff, 2.0f);
+		});
+		run("convex_fill", [&](tess::Painter& pt) {
+			pt.AddPolygonFilled(convex.data(), convex.size(), 0xffff0000);
+		});
+		run("convex_fill_cw", [&](tess::Painter& pt) {
+			pt.AddPolygonFilled(convex_cw.data(), convex_cw.size(), 0xffff0000);
+		});
+		run("circle_fill", [&](tess::Painter& pt) {
+			pt.AddCircleFilled(sm::vec2(100, 100), 80, 0xffffffff, 1021);
+		});
+	}
+	return outputs;
+}
+
+// the start of a polyline cut off, its other points keep their vertices
+int check_offsets()
+{
+	const auto polyline = make_polyline(4099, 2);
+	const size_t VTX_PER_POINT = 4;	// the thick AA stroke
+
+	std::vector<float> base;
+	int fails = 0;
+	for (size_t skip = 0; skip < 16; ++skip)
+	{
+		tess::Painter pt(tess::IndexType::UInt32);
+		pt.AddPolyline(polyline.data() + skip, polyline.size() - skip, 0xffffffff, 3.0f);
+		auto& vertices = pt.GetBuffer().vertices;
+		if (skip == 0)
+		{
+			for (auto& v : vertices) {
+				base.push_back(v.GetPos().x);
+				base.push_back(v.GetPos().y);
+			}
+			continue;
+		}
+
+		// the first point of the cut polyline is an end, not a join
+		float max_diff = 0;
+		for (size_t i = VTX_PER_POINT; i < vertices.size(); ++i)
+		{
+			const size_t j = i + skip * VTX_PER_POINT;
+			const sm::vec2 p = vertices[i].GetPos();
+			max_diff = std::max(max_diff, std::max(std::abs(p.x - base[j * 2]), std::abs(p.y - base[j * 2 + 1])));
+		}
+		if (max_diff > TOLERANCE)
+		{
+			printf("FAIL offset %zu: max diff %g\n", skip, max_diff);
+			++fails;
+		}
+	}
+	return fails;
+}
+
+template <typename T>
+void write_array(FILE* f, const std::vector<T>& arr)
+{
+	const uint64_t size = arr.size();
+	fwrite(&size, sizeof(size), 1, f);
+	fwrite(arr.data(), sizeof(T), arr.size(), f);
+}
+
+template <typename T>
+bool read_array(FILE* f, std::vector<T>& arr)
+{
+	uint64_t size = 0;
+	if (fread(&size, sizeof(size), 1, f) != 1) {
+		return false;
+	}
+	arr.resize(static_cast<size_t>(size));
+	return fread(arr.data(), sizeof(T), arr.size(), f) == arr.size();
+}
+
+bool write_outputs(const char* path, const std::vector<Output>& outputs)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		return false;
+	}
+	for (auto& out : outputs)
+	{
+		write_array(f, std::vector<char>(out.name.begin(), out.name.end()));
+		write_array(f, out.positions);
+		write_array(f, out.cols);
+		write_array(f, out.indices);
+	}
+	fclose(f);
+	return true;
+}
+
+bool read_outputs(const char* path, std::vector<Output>& outputs)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+	std::vector<char> name;
+	while (read_array(f, name))
+	{
+		Output out;
+		out.name.assign(name.begin(), name.end());
+		if (!read_array(f, out.positions) || !read_array(f, out.cols) || !read_array(f, out.indices)) {
+			break;
+		}
+		outputs.push_back(out);
+	}
+	fclose(f);
+	return true;
+}
+
+int compare_outputs(const std::vector<Output>& ref, const std::vector<Output>& outputs)
+{
+	if (ref.size() != outputs.size())
+	{
+		printf("FAIL %zu cases against %zu in the reference\n", outputs.size(), ref.size());
+		return 1;
+	}
+
+	int fails = 0;
+	for (size_t i = 0; i < ref.size(); ++i)
+	{
+		auto& r = ref[i];
+		auto& o = outputs[i];
+		if (r.name != o.name || r.positions.size() != o.positions.size() || r.cols != o.cols || r.indices != o.indices)
+		{
+			printf("FAIL %s: different mesh than the reference %s\n", o.name.c_str(), r.name.c_str());
+			++fails;
+			continue;
+		}
+
+		float max_diff = 0;
+		size_t diff_count = 0;
+		for (size_t j = 0; j < r.positions.size(); ++j)
+		{
+			const float d = std::abs(r.positions[j] - o.positions[j]);
+			max_diff = std::max(max_diff, d);
+			if (d != 0) {
+				++diff_count;
+			}
+		}
+		const bool ok = max_diff <= TOLERANCE;
+		printf("%s %-28s %8zu vertices, %6zu coords differ, max %g\n",
+			ok ? "ok  " : "FAIL", o.name.c_str(), r.positions.size() / 2, diff_count, max_diff);
+		if (!ok) {
+			++fails;
+		}
+	}
+	return fails;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3 || (strcmp(argv[1], "--write") != 0 && strcmp(argv[1], "--compare") != 0))
+	{
+		printf("usage: %s --write|--compare reference_file\n", argv[0]);
+		return 2;
+	}
+
+	int fails = check_offsets();
+	const auto outputs = run_cases();
+	if (strcmp(argv[1], "--write") == 0)
+	{
+		if (!write_outputs(argv[2], outputs))
+		{
+			printf("FAIL cannot write %s\n", argv[2]);
+			return 1;
+		}
+	}
+	else
+	{
+		std::vector<Output> ref;
+		if (!read_outputs(argv[2], ref))
+		{
+			printf("FAIL cannot read %s\n", argv[2]);
+			return 1;
+		}
+		fails += compare_outputs(ref, outputs);
+	}
+
+	printf("%d failed\n", fails);
+	return fails == 0 ? 0 : 1;
+}
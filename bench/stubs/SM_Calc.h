@@ -0,0 +1,4 @@
+#pragma once
+// stand-in for the sm math library, only what the painter uses
+#include "SM_Vector.h"
+namespace sm { inline float dis_pos_to_pos(const vec2& a, const vec2& b) { return (a - b).Length(); } }
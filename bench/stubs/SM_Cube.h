@@ -0,0 +1,4 @@
+#pragma once
+// stand-in for the sm math library, only what the painter uses
+#include "SM_Vector.h"
+namespace sm { struct cube { float min[3] = {0,0,0}, max[3] = {0,0,0}; }; }
@@ -0,0 +1,29 @@
+#pragma once
+// stand-in for the sm math library, only what the painter uses
+#include "SM_Vector.h"
+namespace sm {
+struct mat4 {
+	union { float c[4][4]; float x[16]; };
+	mat4() { for (int i = 0; i < 16; ++i) x[i] = (i % 5 == 0) ? 1.f : 0.f; }
+	static mat4 RotatedZ(float deg) {
+		mat4 m; float r = deg * SM_DEG_TO_RAD, s = std::sin(r), c = std::cos(r);
+		m.x[0] = c; m.x[1] = s; m.x[4] = -s; m.x[5] = c; return m;
+	}
+	vec3 operator*(const vec3& v) const {
+		float w = x[3] * v.x + x[7] * v.y + x[11] * v.z + x[15];
+		return vec3((x[0] * v.x + x[4] * v.y + x[8] * v.z + x[12]) / w,
+		            (x[1] * v.x + x[5] * v.y + x[9] * v.z + x[13]) / w,
+		            (x[2] * v.x + x[6] * v.y + x[10] * v.z + x[14]) / w);
+	}
+	mat4 operator*(const mat4& b) const {
+		mat4 m;
+		for (int col = 0; col < 4; ++col)
+			for (int row = 0; row < 4; ++row) {
+				float s = 0;
+				for (int k = 0; k < 4; ++k) s += x[k * 4 + row] * b.x[col * 4 + k];
+				m.x[col * 4 + row] = s;
+			}
+		return m;
+	}
+};
+}
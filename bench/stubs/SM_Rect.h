@@ -0,0 +1,15 @@
+#pragma once
+// stand-in for the sm math library, only what the painter uses
+#include "SM_Vector.h"
+#include <cfloat>
+namespace sm {
+struct rect {
+	float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+	rect() = default;
+	rect(const vec2& min, const vec2& max) : xmin(min.x), ymin(min.y), xmax(max.x), ymax(max.y) {}
+	float Width() const { return xmax - xmin; }
+	float Height() const { return ymax - ymin; }
+	bool IsValid() const { return xmin <= xmax && ymin <= ymax; }
+	void MakeEmpty() { xmin = ymin = FLT_MAX; xmax = ymax = -FLT_MAX; }
+};
+}
@@ -0,0 +1,40 @@
+#pragma once
+// stand-in for the sm math library, only what the painter uses
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#define SM_PI 3.1415926f
+#define SM_RAD_TO_DEG (180.0f / SM_PI)
+#define SM_DEG_TO_RAD (SM_PI / 180.0f)
+namespace sm {
+struct vec2 {
+	float x = 0, y = 0;
+	vec2() = default;
+	vec2(float x, float y) : x(x), y(y) {}
+	vec2 operator+(const vec2& o) const { return vec2(x + o.x, y + o.y); }
+	vec2 operator-(const vec2& o) const { return vec2(x - o.x, y - o.y); }
+	vec2 operator-() const { return vec2(-x, -y); }
+	vec2 operator*(float s) const { return vec2(x * s, y * s); }
+	vec2 operator/(float s) const { return vec2(x / s, y / s); }
+	vec2& operator+=(const vec2& o) { x += o.x; y += o.y; return *this; }
+	vec2& operator-=(const vec2& o) { x -= o.x; y -= o.y; return *this; }
+	vec2& operator*=(float s) { x *= s; y *= s; return *this; }
+	bool operator==(const vec2& o) const { return x == o.x && y == o.y; }
+	bool operator!=(const vec2& o) const { return !(*this == o); }
+	float LengthSquared() const { return x * x + y * y; }
+	float Length() const { return std::sqrt(LengthSquared()); }
+};
+struct vec3 {
+	float x = 0, y = 0, z = 0;
+	vec3() = default;
+	vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+	vec3 operator+(const vec3& o) const { return vec3(x + o.x, y + o.y, z + o.z); }
+	vec3 operator-(const vec3& o) const { return vec3(x - o.x, y - o.y, z - o.z); }
+	vec3 operator*(float s) const { return vec3(x * s, y * s, z * s); }
+};
+struct vec4 {
+	float x = 0, y = 0, z = 0, w = 0;
+	vec4() = default;
+	vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+};
+}
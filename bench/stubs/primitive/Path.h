@@ -0,0 +1,27 @@
+#pragma once
+// stand-in for the primitive library, only what the painter uses
+#include <SM_Vector.h>
+#include <vector>
+namespace prim {
+class Path {
+public:
+	struct SubPath { std::vector<sm::vec2> vertices; bool closed = false; };
+	void MoveTo(const sm::vec2& p) {
+		if (!m_curr.empty()) { m_prev.push_back({ m_curr, false }); m_curr.clear(); }
+		m_curr.push_back(p);
+	}
+	void LineTo(const sm::vec2& p) { m_curr.push_back(p); }
+	void Arc(const sm::vec2& c, float r, float a0, float a1, int n) {
+		if (r == 0.0f) { m_curr.push_back(c); return; }
+		for (int i = 0; i <= n; ++i) {
+			const float a = a0 + ((float)i / (float)n) * (a1 - a0);
+			m_curr.push_back(sm::vec2(c.x + std::cos(a) * r, c.y + std::sin(a) * r));
+		}
+	}
+	const std::vector<SubPath>& GetPrevPaths() const { return m_prev; }
+	const std::vector<sm::vec2>& GetCurrPath() const { return m_curr; }
+private:
+	std::vector<SubPath> m_prev;
+	std::vector<sm::vec2> m_curr;
+};
+}
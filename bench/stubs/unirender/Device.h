@@ -0,0 +1,5 @@
+#pragma once
+// stand-in for unirender, Palette does not create a real texture
+#include "typedef.h"
+#include <cstddef>
+namespace ur { class Device { public: TexturePtr CreateTexture(int, int, TextureFormat, const void*, size_t) const { return nullptr; } }; }
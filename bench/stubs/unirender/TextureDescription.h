@@ -0,0 +1,2 @@
+#pragma once
+// stand-in for unirender, Palette does not create a real texture
@@ -0,0 +1,4 @@
+#pragma once
+// stand-in for unirender, Palette does not create a real texture
+#include <memory>
+namespace ur { class Texture; using TexturePtr = std::shared_ptr<Texture>; enum class TextureFormat { RGBA8 }; }
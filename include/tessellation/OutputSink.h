@@ -0,0 +1,60 @@
+#pragma once
+
+#include "tessellation/Painter.h"
+#include "tessellation/PodArray.h"
+
+#include <vector>
+
+namespace tess
+{
+
+// Fixed size chunks of caller memory for Painter::SetOutputSink(), e.g. slices of a mapped
+// GPU ring buffer. With IndexType::UInt16 a chunk holds at most MAX_VERTICES_16 vertices.
+class OutputSink
+{
+public:
+	struct Chunk
+	{
+		Painter::Vertex* vertices = nullptr;
+		size_t           vtx_capacity = 0;
+		void*            indices = nullptr;	// of the painter's index type
+		size_t           idx_capacity = 0;
+	};
+
+	virtual ~OutputSink() {}
+
+	virtual Chunk Acquire(IndexType index_type) = 0;
+	// the filled chunk, buf's vertices and indices point into it
+	virtual void Flush(const Painter::Buffer& buf) = 0;
+
+}; // OutputSink
+
+// Reuses one chunk and copies each flushed one out, standing in for the GPU
+class MemorySink : public OutputSink
+{
+public:
+	struct Batch
+	{
+		std::vector<Painter::Cmd> commands;	// offsets into this batch
+		PodArray<Painter::Vertex> vertices;
+		PodArray<uint32_t>        indices;
+	};
+
+	MemorySink(size_t vtx_capacity, size_t idx_capacity);
+
+	virtual Chunk Acquire(IndexType index_type) override;
+	virtual void Flush(const Painter::Buffer& buf) override;
+
+	auto& GetBatches() const { return m_batches; }
+	void Clear() { m_batches.clear(); }
+
+private:
+	PodArray<Painter::Vertex> m_vertices;
+	PodArray<unsigned short>  m_indices;
+	PodArray<uint32_t>        m_indices32;
+
+	std::vector<Batch> m_batches;
+
+}; // MemorySink
+
+}
@@ -3,10 +3,36 @@
 #include <SM_Vector.h>
 #include <SM_Matrix.h>
 #include <SM_Cube.h>
+#include <SM_Rect.h>
+
+#include "tessellation/PodArray.h"
+#include "tessellation/ShapeCache.h"
+#include "tessellation/Triangulator.h"
 
 #include <vector>
+#include <array>
 #include <functional>
 #include <memory>
+#include <cstdint>
+
+// Painter::Vertex layouts, pick one by defining TESS_VERTEX_LAYOUT for the whole build
+#define TESS_VERTEX_POS_UV_COL 0	// 20 bytes, the default, the only one with AddTexQuad()
+#define TESS_VERTEX_POS_COL    1	// 12 bytes, solid geometry drawn without texture
+#define TESS_VERTEX_POS16_COL  2	// 8 bytes, positions in int16 fixed point of 1 / TESS_VERTEX_POS16_SCALE
+
+#ifndef TESS_VERTEX_LAYOUT
+#define TESS_VERTEX_LAYOUT TESS_VERTEX_POS_UV_COL
+#endif
+
+// subpixel steps of TESS_VERTEX_POS16_COL, 4 covers [-8192, 8192) in quarter pixels
+#ifndef TESS_VERTEX_POS16_SCALE
+#define TESS_VERTEX_POS16_SCALE 4
+#endif
+
+// Painter::GetStats() and the profiler hooks, define to 1 for the whole build
+#ifndef TESS_ENABLE_STATS
+#define TESS_ENABLE_STATS 0
+#endif
 
 namespace prim { class Path; }
 
@@ -26,20 +52,55 @@ static const uint32_t CORNER_FLAGS_ALL   = 0xF;
 
 static const uint32_t ANTI_ALIASED_LINES = 0x1;
 static const uint32_t ANTI_ALIASED_FILL  = 0x2;
+// strokes and convex fills anti-aliased by the shader instead of a fringe, see SetAnalyticAntiAliased()
+static const uint32_t ANALYTIC_AA        = 0x4;
 
 static const float    DEFAULT_POINT_SIZE      = 5.0f;
 static const float    DEFAULT_LINE_WIDTH      = 1.0f;
 static const float    DEFAULT_DASH_LINE_STEP  = 2.0f;
 static const uint32_t DEFAULT_CIRCLE_SEGMENTS = 12;
 
+// segment count from the radius and Painter::SetCircleMaxError(),
+// DEFAULT_CIRCLE_SEGMENTS while no max error is set
+static const uint32_t CIRCLE_SEGMENTS_AUTO = 0;
+
+// Cmd::texid of everything drawn with the palette
+static const int PALETTE_TEXID = 0;
+
+enum class IndexType
+{
+	UInt16,	// new draw command when the vertex base would pass 65535
+	UInt32,
+};
+
+struct MeshSize
+{
+	size_t vtx_count = 0;
+	size_t idx_count = 0;
+
+	MeshSize& operator += (const MeshSize& sz) {
+		vtx_count += sz.vtx_count;
+		idx_count += sz.idx_count;
+		return *this;
+	}
+};
+
 class Palette;
+class OutputSink;
+struct Shape;
 
 class Painter
 {
 public:
 	Painter() = default;
+	explicit Painter(IndexType index_type);
 	Painter(const Painter& pt);
 	Painter& operator = (const Painter& pt);
+	// take the buffers with their capacity, the shape cache and the output sink along
+	Painter(Painter&& pt) noexcept;
+	Painter& operator = (Painter&& pt) noexcept;
+
+	void swap(Painter& pt) noexcept;
 
 	// 2d
 	void AddLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
@@ -47,17 +108,28 @@ public:
 	void AddRect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE);
 	void AddRectFilled(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE);
     void AddRectFilled(const sm::vec2& center, float radius, uint32_t col, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE);
-	void AddCircle(const sm::vec2& centre, float radius, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = DEFAULT_CIRCLE_SEGMENTS);
-	void AddCircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments = DEFAULT_CIRCLE_SEGMENTS);
-	void AddArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = DEFAULT_CIRCLE_SEGMENTS);
+	void AddCircle(const sm::vec2& centre, float radius, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
+	void AddCircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
+	void AddArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
 	void AddTriangle(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
 	void AddTriangleFilled(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col);
 	void AddPolyline(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
 	void AddPolylineMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, float line_width = DEFAULT_LINE_WIDTH);
     void AddPolylineDash(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, float step_len = DEFAULT_DASH_LINE_STEP);
+	// Dashes and gaps taking turns with the lengths of pattern, an odd count of them repeats twice
+	// as in SVG. phase is how far into the pattern the line starts. The pattern carries on around
+	// the corners, and a pattern without a positive length draws the whole line.
+	void AddPolylineDash(const sm::vec2* points, size_t count, const float* pattern, size_t pattern_count,
+		float phase, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
 	void AddPolygon(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	// any simple polygon, in either direction
 	void AddPolygonFilled(const sm::vec2* points, size_t count, uint32_t col);
+	// contours packed one after another, nested ones cut holes by the rule. they may not cross,
+	// not covered by the Calc*Size() queries.
+	void AddPolygonFilled(const sm::vec2* points, const size_t* counts, size_t contour_count, uint32_t col, FillRule rule = FillRule::EvenOdd);
 	void AddPath(const prim::Path& path, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	// all the subpaths as contours of one polygon, see AddPolygonFilled()
+	void AddPathFilled(const prim::Path& path, uint32_t col, FillRule rule = FillRule::EvenOdd);
 
 	// 3d
 	using Trans2dFunc = std::function<sm::vec2(const sm::vec3)>;
@@ -70,82 +142,573 @@ public:
 	void AddPolygon3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
 	void AddPolygonFilled3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col);
 
+	// projected in one pass by a view-projection matrix, and clipped against the near plane
+	// (z >= -w in clip space) before tessellation. not covered by the Calc*3DSize() queries.
+	struct Viewport
+	{
+		Viewport() {}
+		Viewport(float x, float y, float w, float h) : x(x), y(y), w(w), h(h) {}
+
+		// ndc [-1, 1] maps to [x, x + w] and [y, y + h]
+		float x = 0, y = 0, w = 0, h = 0;
+	};
+	void AddPoint3D(const sm::vec3& p, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float size = DEFAULT_POINT_SIZE);
+	void AddLine3D(const sm::vec3& p0, const sm::vec3& p1, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	void AddCube(const sm::cube& cube, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	void AddArc3D(const sm::mat4& mat, float radius, float start_angle, float end_angle, const sm::mat4& view_proj, const Viewport& vp,
+		uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = DEFAULT_CIRCLE_SEGMENTS);
+	void AddPolyline3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, bool closed = false);
+	void AddPolygon3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	void AddPolygonFilled3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col);
+
 	// ext
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
 	void AddTexQuad(int tex, const std::array<sm::vec2, 4>& positions, const std::array<sm::vec2, 4>& texcoords, uint32_t color);
+#endif
+
+	void AddShape(const Shape& shape);
+
+	// exact output of the Add* call with the same params and current flags, for a visible color
+	// and a shape inside the clip rect
+	MeshSize CalcLineSize(float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcDashLineSize(const sm::vec2& p0, const sm::vec2& p1, float line_width = DEFAULT_LINE_WIDTH, float step_len = DEFAULT_DASH_LINE_STEP) const;
+	MeshSize CalcRectSize(float line_width = DEFAULT_LINE_WIDTH, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE) const;
+	MeshSize CalcRectFilledSize(float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE) const;
+	MeshSize CalcCircleSize(float radius, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO) const;
+	MeshSize CalcCircleFilledSize(float radius, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO) const;
+	MeshSize CalcArcSize(float radius, float start_angle, float end_angle, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO) const;
+	MeshSize CalcTriangleSize(float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcTriangleFilledSize() const;
+	MeshSize CalcPolylineSize(size_t count, float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcPolylineDashSize(const sm::vec2* points, size_t count, float line_width = DEFAULT_LINE_WIDTH, float step_len = DEFAULT_DASH_LINE_STEP) const;
+	MeshSize CalcPolylineDashSize(const sm::vec2* points, size_t count, const float* pattern, size_t pattern_count,
+		float phase, float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcPolygonSize(size_t count, float line_width = DEFAULT_LINE_WIDTH) const;
+	// with ANALYTIC_AA, of a convex polygon
+	MeshSize CalcPolygonFilledSize(size_t count) const;
+	// exact for concave ones too, they keep the fringe with ANALYTIC_AA
+	MeshSize CalcPolygonFilledSize(const sm::vec2* points, size_t count) const;
+	MeshSize CalcPathSize(const prim::Path& path, float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcPoint3DSize(float size = DEFAULT_POINT_SIZE) const;
+	MeshSize CalcCubeSize(float line_width = DEFAULT_LINE_WIDTH) const;
+	MeshSize CalcArc3DSize(float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = DEFAULT_CIRCLE_SEGMENTS) const;
+	MeshSize CalcPolyline3DSize(size_t count, float line_width = DEFAULT_LINE_WIDTH, bool closed = false) const;
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	MeshSize CalcTexQuadSize() const;
+#endif
+	MeshSize CalcShapeSize(const Shape& shape) const;
 
 	void AddPainter(const Painter& pt);
-	void FillPainter(const Painter& pt, size_t vert_off, size_t index_off, size_t tex_off);
+	// AddPainter() for each in order, the buffers grow once. Commands with the same state
+	// join across painters where the vertex base allows it.
+	void MergePainters(const Painter* const* painters, size_t count);
+	// room for that much more output, so the Add* calls up to it do not reallocate
+	void Preallocate(const MeshSize& size);
+	// preallocate with Resize(), then fill ranges from other painters
+	void Resize(size_t vtx_count, size_t idx_count, size_t cmd_count);
+	// the ranges FillPainter() takes for pt, more than pt's own for a 32-bit pt with more
+	// vertices than a 16-bit command holds, as it is cut up like AddPainter() does
+	void CalcPainterSize(const Painter& pt, MeshSize& size, size_t& cmd_count) const;
+	void FillPainter(const Painter& pt, size_t vert_off, size_t index_off, size_t cmd_off);
+	// pt's instances, which FillPainter() leaves out, drawn after the index_off first indices
+	void AddInstances(const Painter& pt, size_t index_off);
+
+	// one Reserve() call of a painter: where its vertices and indices start and the command
+	struct Reservation
+	{
+		size_t vtx_begin = 0, idx_begin = 0, cmd = 0;
+	};
+	// a run of a painter's vertices and indices and where they go, the indices moved by delta
+	struct Placement
+	{
+		size_t   src_vtx = 0, dst_vtx = 0, vtx_count = 0;
+		size_t   src_idx = 0, dst_idx = 0, idx_count = 0;
+		uint32_t delta = 0;
+	};
+	// Reserve() notes its calls in log until it is reset to nullptr
+	void LogReservations(PodArray<Reservation>* log);
+	// for 16-bit painters, the commands serial Add* calls would give. PackPainter() replays
+	// the Reserve() calls pt logged and notes where its data goes, FillPacked() copies it
+	// there, for several painters in parallel
+	void PackPainter(const Painter& pt, const PodArray<Reservation>& log, PodArray<Placement>& places);
+	void FillPacked(const Painter& pt, const PodArray<Placement>& places);
+	// joins neighbouring commands with the same state, e.g. after FillPainter()
+	void MergeCommands();
+	// Buffer::Optimize(), for static geometry uploaded once and drawn many times
+	void Optimize();
+
+	// an invalid rect (the default) disables clipping. Add* calls drop shapes out of the rect,
+	// AddPolyline() and AddPolylineMultiColor() only stroke the runs of points near it.
+	void PushClipRect(const sm::rect& rect, bool intersect_with_current = false);
+	void PopClipRect();
 
 	bool IsEmpty() const;
 
+	// the output and the clip rects, flags and the other settings stay
 	void Clear();
 
     void SetAntiAliased(bool enable);
+	// The anti-aliased strokes and convex fills get no fringe, only an edge distance in Vertex::uv.x:
+	// -1 or 1 on their outer edges, 0 on the center line or at the center. The rest of the palette
+	// geometry gets 0, and uv no longer points at the palette, so the shader skips the texture and
+	// takes its coverage from
+	//     clamp((1.0 - abs(uv.x)) / max(fwidth(uv.x), 1e-4), 0.0, 1.0)
+	// Concave fills keep their fringe. Needs TESS_VERTEX_POS_UV_COL, ignored by the other layouts.
+	void SetAnalyticAntiAliased(bool enable);
+
+	uint32_t GetFlags() const { return m_flags; }
+	void SetFlags(uint32_t flags) { m_flags = flags; }
 
 	void SetPalette(const std::shared_ptr<Palette>& palette) { m_palette = palette; }
 	auto GetPalette() const { return m_palette; }
 
+	// max distance between a circle and its polygon, in pixels, for CIRCLE_SEGMENTS_AUTO.
+	// 0 turns the auto mode off.
+	void SetCircleMaxError(float max_error) { m_circle_max_error = max_error; }
+	float GetCircleMaxError() const { return m_circle_max_error; }
+
+	// max distance between a polyline and its simplified points, in pixels. AddPolyline(),
+	// AddPolylineMultiColor() and the projected AddPolyline3D(), AddPolygon3D() and AddArc3D()
+	// keep only the first, last, lowest and highest of consecutive points in a column this wide,
+	// with their own colors. The Calc*Size() queries are upper bounds then. 0 keeps every point.
+	void SetPolylineMaxError(float max_error) { m_polyline_max_error = max_error; }
+	float GetPolylineMaxError() const { return m_polyline_max_error; }
+
+	// Circles and rects with the size, line width, segments and flags of one drawn before
+	// are copied from a cache, only moved and recolored. Off by default, not copied with the painter.
+	void EnableShapeCache(bool enable);
+	bool IsShapeCacheEnabled() const { return m_shape_cache != nullptr; }
+
+	// AddCircleFilled(), AddRectFilled() and AddPoint3D() append an Instance to GetInstanceBuffer()
+	// instead of triangles, to be drawn with a mesh from BuildInstanceMesh(). Rects rounding only
+	// some of their corners are still tessellated. Off by default.
+	void EnableInstancing(bool enable) { m_instancing = enable; }
+	bool IsInstancingEnabled() const { return m_instancing; }
+
+	// Vertices and indices go straight into the chunks of the sink, which gets each one back
+	// with its commands in Flush() once the next shape does not fit in. The buffer only holds
+	// the current chunk then, with offsets from its start. A shape bigger than a whole chunk
+	// is built in the painter's own memory and flushed from there, AddPainter() cuts bigger
+	// vertex blocks of the other painter into runs of triangles instead. Setting or clearing the sink
+	// flushes the old one and drops what was drawn without it. Null by default, not copied.
+	void SetOutputSink(OutputSink* sink);
+	OutputSink* GetOutputSink() const { return m_buf.sink; }
+	// hands the current chunk to the sink, e.g. at the end of a frame
+	void FlushOutput();
+
 public:
 	struct Vertex
 	{
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS16_COL
+		int16_t  pos[2];
+#else
 		sm::vec2 pos;
+#endif
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
 		sm::vec2 uv;
+#endif
 		uint32_t col = 0;
+
+		// the same in every layout
+		sm::vec2 GetPos() const;
+		void SetPos(const sm::vec2& p);
 	};
 
-	//struct Cmd
-	//{
-	//	size_t elem_count = 0;
-	//};
+	struct Cmd
+	{
+		size_t elem_count = 0;	// indices
+		size_t idx_offset = 0;	// first index
+		size_t vtx_offset = 0;	// added to each index, always 0 with IndexType::UInt32
+
+		int      texid = PALETTE_TEXID;
+		sm::rect clip_rect;
+	};
 
 	struct Buffer
 	{
+		static const size_t MAX_VERTICES_16 = 0x10000;
+
 		Buffer() = default;
+		explicit Buffer(IndexType index_type);
 		Buffer(const Buffer& buf);
 		Buffer& operator = (const Buffer& buf);
+		Buffer(Buffer&& buf) noexcept;
+		Buffer& operator = (Buffer&& buf) noexcept;
+
+		void swap(Buffer& buf) noexcept;
 
 		void Reserve(size_t idx_count, size_t vtx_count);
+		// capacity for that many more, so the Reserve() calls after it do not reallocate
+		void Preallocate(size_t idx_count, size_t vtx_count);
+		void Append(const Buffer& src);
+		void MergeCommands();
+		// Welds bitwise equal vertices, reorders the triangles of each command for the
+		// post-transform vertex cache and the vertices by their first use. Commands keep
+		// their index ranges, but overlapping translucent triangles of one command may
+		// blend in another order.
+		void Optimize();
+
+		// with a sink, flushes the chunk unless that many more fit in
+		void Fit(size_t idx_count, size_t vtx_count);
+		void FlushChunk();
 
 		void Clear();
 
-//		std::vector<Cmd>            commands;
-		std::vector<Vertex>         vertices;
-		std::vector<unsigned short> indices;
+		size_t IndexCount() const {
+			return index_type == IndexType::UInt32 ? indices32.size() : indices.size();
+		}
+		size_t IndexCapacity() const {
+			return index_type == IndexType::UInt32 ? indices32.capacity() : indices.capacity();
+		}
+
+		// including the chunks flushed to the sink
+		size_t TotalVertexCount() const { return flushed_vtx + vertices.size(); }
+		size_t TotalIndexCount() const { return flushed_idx + IndexCount(); }
 
-		unsigned short  curr_index = 0;
+		template <typename T>
+		T*& IndexPtr();
+
+		IndexType index_type = IndexType::UInt16;
+
+		std::vector<Cmd>         commands;
+		PodArray<Vertex>         vertices;
+		PodArray<unsigned short> indices;	// IndexType::UInt16
+		PodArray<uint32_t>       indices32;	// IndexType::UInt32
+
+		// state of the next command
+		int      curr_texid = PALETTE_TEXID;
+		sm::rect curr_clip_rect;
+
+		// relative to commands.back().vtx_offset
+		uint32_t        curr_index = 0;
 		Vertex*         vert_ptr = nullptr;
 		unsigned short* index_ptr = nullptr;
+		uint32_t*       index32_ptr = nullptr;
+
+		OutputSink* sink = nullptr;
+		size_t      flushed_vtx = 0, flushed_idx = 0;
+
+		// not copied with the buffer
+		PodArray<Reservation>* reservations = nullptr;
+
+#if TESS_ENABLE_STATS
+		// growths of the arrays in Reserve() and what they copied
+		size_t reallocs = 0, bytes_moved = 0;
+#endif // TESS_ENABLE_STATS
 	};
 
-	// for different tex
-	struct TexRegion
+	auto& GetBuffer() const { return m_buf; }
+
+	enum class InstanceKind
 	{
-		int texid;
-		int begin, end;
+		Circle,
+		Rect,
 	};
 
-	auto& GetBuffer() const { return m_buf; }
-	auto& GetOtherTexRegion() const { return m_other_texs; }
+	// each vertex of its kind's mesh goes to center + corner * (half_size - rounding) + dir * rounding + fringe
+	struct Instance
+	{
+		sm::vec2 center;
+		sm::vec2 half_size;
+		float    rounding;	// the radius for circles
+		uint32_t col;
+	};
+
+	struct InstanceCmd
+	{
+		InstanceKind kind = InstanceKind::Circle;
+		size_t first = 0, count = 0;	// instances
+		size_t idx_count = 0;			// the buffer's indices drawn before these, counting flushed chunks
+
+		sm::rect clip_rect;
+	};
+
+	struct InstanceBuffer
+	{
+		// idx_count of the buffer src is appended after
+		void Append(const InstanceBuffer& src, size_t idx_count);
+		void Clear();
+
+		std::vector<InstanceCmd> commands;
+		PodArray<Instance>       instances;
+	};
+
+	auto& GetInstanceBuffer() const { return m_instances; }
+
+	struct InstanceVertex
+	{
+		sm::vec2 corner;	// -1 or 1 on each axis, 0 for circles
+		sm::vec2 dir;		// unit length on arcs, the corner itself on sharp corners
+		sm::vec2 fringe;	// half a pixel in or out with anti-aliasing, 0 without
+		float    alpha;		// scales the instance color's alpha
+	};
+
+	struct InstanceMesh
+	{
+		std::vector<InstanceVertex> vertices;
+		std::vector<unsigned short> indices;
+	};
+
+	// num_segments is for the whole circle, or for each corner of a rect where 0 gives sharp corners
+	static InstanceMesh BuildInstanceMesh(InstanceKind kind, uint32_t num_segments, bool anti_aliased);
+
+#if TESS_ENABLE_STATS
+	// of the Add* calls, an Add* call made by another one counts for the outer call
+	enum class StatsKind
+	{
+		Line,
+		DashLine,
+		Rect,
+		RectFilled,
+		Circle,
+		CircleFilled,
+		Arc,
+		Triangle,
+		TriangleFilled,
+		Polyline,
+		PolylineDash,
+		Polygon,
+		PolygonFilled,
+		Path,
+		PathFilled,
+		Point3D,
+		Line3D,
+		Cube,
+		Arc3D,
+		Polyline3D,
+		Polygon3D,
+		PolygonFilled3D,
+		TexQuad,
+		Painter,	// AddPainter(), MergePainters() and FillPainter()
+
+		Count
+	};
+
+	struct KindStats
+	{
+		uint64_t calls = 0;
+		uint64_t alpha_rejects = 0;			// dropped for a color without alpha
+		uint64_t vertices = 0, indices = 0;	// emitted
+		uint64_t reallocs = 0;				// growths of the buffer's arrays
+		uint64_t bytes_moved = 0;			// copied by those growths
+		uint64_t time_ns = 0;
+
+		KindStats& operator += (const KindStats& st);
+	};
+
+	struct Stats
+	{
+		std::array<KindStats, static_cast<size_t>(StatsKind::Count)> kinds;
+
+		KindStats& operator [] (StatsKind kind) { return kinds[static_cast<size_t>(kind)]; }
+		const KindStats& operator [] (StatsKind kind) const { return kinds[static_cast<size_t>(kind)]; }
+		KindStats Total() const;
+	};
+
+	// since the painter was created or ResetStats(), not copied with it
+	auto& GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = Stats(); }
+
+	static const char* GetStatsKindName(StatsKind kind);
+
+	// called around each counted Add* call with the kind's name, e.g. to open a profiler zone.
+	// Shared by all painters, set it before drawing starts.
+	struct ProfilerHooks
+	{
+		void (*begin)(const char* name, void* user) = nullptr;
+		void (*end)(const char* name, void* user) = nullptr;
+		void* user = nullptr;
+	};
+	static void SetProfilerHooks(const ProfilerHooks& hooks);
+#endif // TESS_ENABLE_STATS
 
 private:
-	static prim::Path PathRect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding, uint32_t rounding_corners_flags);
+	// outline points into m_points, returns the count
+	size_t PathRect(const sm::vec2& p0, const sm::vec2& p1, float rounding, uint32_t rounding_corners_flags);
+	size_t PathArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t num_segments);
+	size_t PathRectCount(float rounding, uint32_t rounding_corners_flags) const;
+	static size_t PathArcCount(float radius, int num_segments);
+
+	// resolves CIRCLE_SEGMENTS_AUTO
+	uint32_t CircleSegments(float radius, uint32_t num_segments) const;
+	uint32_t ArcSegments(float radius, float start_angle, float end_angle, uint32_t num_segments) const;
+	uint32_t RectCornerSegments(float rounding) const;
+
+	// with the 16-bit runs of StrokeMultiColor
+	MeshSize CalcStrokeSize(size_t count, bool closed, float line_width) const;
+	// one run
+	MeshSize CalcStrokeRunSize(size_t count, bool closed, float line_width) const;
+	MeshSize CalcFillSize(size_t count) const { return CalcFillSize(count, m_flags); }
+	MeshSize CalcFillSize(size_t count, uint32_t flags) const;
 
 	void Stroke(const sm::vec2* points, size_t count, uint32_t col, bool closed, float line_width = DEFAULT_LINE_WIDTH);
 	void StrokeMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, bool closed, float line_width = DEFAULT_LINE_WIDTH);
-	void Fill(const sm::vec2* points, size_t count, uint32_t col);
+	// a convex outline going clockwise on screen, reversed flips the AA fringe for the other way.
+	// keep_fringe draws the fringe with ANALYTIC_AA too, as FillTriangulated() does
+	void Fill(const sm::vec2* points, size_t count, uint32_t col, bool reversed = false, bool keep_fringe = false);
+	// convex outlines to Fill(), the others through m_triangulator
+	void FillPolygon(const sm::vec2* points, size_t count, uint32_t col);
+	// the mesh of m_triangulator with the AA fringe on its contours
+	void FillTriangulated(uint32_t col);
+
+	// Color is UniformColor or VertexColor, see Painter.cpp
+	template <typename Color>
+	void StrokeImpl(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	template <typename Index, typename Color>
+	void StrokeRun(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	template <typename Index, typename Color, bool THICK>
+	void StrokeAA(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	template <typename Index, typename Color>
+	void StrokeNoAA(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	template <typename Index, typename Color>
+	void StrokeAnalytic(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	template <typename Index, bool AA>
+	void FillImpl(const sm::vec2* points, size_t count, uint32_t col, bool reversed);
+	template <typename Index>
+	void FillAnalytic(const sm::vec2* points, size_t count, uint32_t col, bool reversed);
+	// uv of the palette geometry without an edge distance
+	sm::vec2 PaletteUV() const;
+	// a mesh with relative indices moved to pos
+	void AddMesh(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col);
+	template <typename Index>
+	void AddMeshImpl(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col);
+	// over 65536 vertices with 16-bit indices, cut into commands of their own
+	void AddMeshSplit(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col);
+	// a 32-bit src with more vertices than one 16-bit command holds
+	bool NeedsSplit(const Buffer& src) const;
+	void FillPainterSplit(const Painter& pt, size_t vert_off, size_t index_off, size_t cmd_off);
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	template <typename Index>
+	void AddTexQuadImpl(int tex, const std::array<sm::vec2, 4>& positions, const std::array<sm::vec2, 4>& texcoords, uint32_t color);
+#endif
 
 	void Stroke(const prim::Path& path, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
-	void Fill(const prim::Path& path, uint32_t col);
+	void Fill(const prim::Path& path, uint32_t col, FillRule rule);
+
+	// false when the bounds grown by margin are out of the clip rect, true without one
+	bool IsVisible(const sm::vec2& min, const sm::vec2& max, float margin) const;
+	bool IsVisible(const sm::vec2* points, size_t count, float margin) const;
+	// an open stroke cut to the runs of segments near the clip rect
+	template <typename Color>
+	void StrokeVisible(const sm::vec2* points, const Color& cols, size_t count, float line_width);
+	// a stroke simplified by m_polyline_max_error first
+	template <typename Color>
+	void StrokeSimplified(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width);
+	// indices of the kept points into m_lod_index, returns their count
+	size_t Simplify(const sm::vec2* points, size_t count);
+
+	// temporary points of the kernels, valid until the next call
+	sm::vec2* Scratch(size_t count);
+
+	// replays the cached mesh at pos, false if not cached
+	bool AddCachedShape(const ShapeCache::Key& key, const sm::vec2& pos, uint32_t col);
+	// caches what was drawn at the origin since vtx_begin and idx_begin, then moves it to pos
+	void CacheShape(const ShapeCache::Key& key, const sm::vec2& pos, uint32_t col, size_t vtx_begin, size_t idx_begin);
+
+	void AddInstance(InstanceKind kind, const sm::vec2& center, const sm::vec2& half_size, float rounding, uint32_t col);
+
+	// strokes the visible runs of the first count points of m_clip_pos
+	void StrokeClipped(size_t count, const Viewport& vp, uint32_t col, bool closed, float line_width);
+	// fills the first count points of m_clip_pos cut by the near plane
+	void FillClipped(size_t count, const Viewport& vp, uint32_t col);
+
+	// the early out of the Add* calls, counted as an alpha reject
+	bool IsTransparent(uint32_t col);
+
+#if TESS_ENABLE_STATS
+	// counts the Add* call it lives in, unless it was made by another one
+	class StatsScope
+	{
+	public:
+		StatsScope(Painter& pt, StatsKind kind);
+		~StatsScope();
+
+	private:
+		Painter&  m_pt;
+		StatsKind m_kind;
+		bool      m_outer;
+
+		size_t  m_vtx_begin, m_idx_begin;
+		size_t  m_reallocs_begin, m_bytes_moved_begin;
+		int64_t m_time_begin;
+	};
+#endif // TESS_ENABLE_STATS
 
 private:
 	uint32_t m_flags = ANTI_ALIASED_LINES | ANTI_ALIASED_FILL;
 
+	bool m_instancing = false;
+
+	float m_circle_max_error = 0;
+	float m_polyline_max_error = 0;
+
 	Buffer m_buf;
 
-	std::vector<TexRegion> m_other_texs;
+	InstanceBuffer m_instances;
+
+	std::vector<sm::rect> m_clip_stack;
 
 	std::shared_ptr<Palette> m_palette = nullptr;
 
+	// grows to the largest request and is reused, not copied with the painter
+	PodArray<sm::vec2> m_scratch;
+
+	// clip space positions of the projected 3d calls
+	PodArray<sm::vec4> m_clip_pos;
+	// outlines built before stroking or filling: arcs, rects, projected 3d points
+	PodArray<sm::vec2> m_points;
+
+	std::unique_ptr<ShapeCache> m_shape_cache = nullptr;
+
+	// concave fills, their meshes are built here before AddMesh()
+	Triangulator       m_triangulator;
+	PodArray<uint32_t> m_mesh_col_masks;
+	PodArray<uint32_t> m_mesh_indices;
+	PodArray<uint32_t> m_mesh_remap;
+
+	// the dashes of AddPolylineDash(), their points one after another
+	PodArray<sm::vec2> m_dash_points;
+	PodArray<uint32_t> m_dash_counts;
+
+	// simplified polylines
+	PodArray<uint32_t> m_lod_index;
+	PodArray<sm::vec2> m_lod_points;
+	PodArray<uint32_t> m_lod_cols;
+
+#if TESS_ENABLE_STATS
+	Stats     m_stats;
+	StatsKind m_stats_kind = StatsKind::Line;	// of the outermost StatsScope
+	int       m_stats_depth = 0;
+#endif // TESS_ENABLE_STATS
+
 }; // Painter
 
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS16_COL
+
+inline sm::vec2 Painter::Vertex::GetPos() const
+{
+	const float s = 1.0f / TESS_VERTEX_POS16_SCALE;
+	return sm::vec2(pos[0] * s, pos[1] * s);
+}
+
+inline void Painter::Vertex::SetPos(const sm::vec2& p)
+{
+	// round to nearest, clamped so the conversion stays defined
+	auto to_fixed = [](float v) {
+		v = v * TESS_VERTEX_POS16_SCALE + (v < 0 ? -0.5f : 0.5f);
+		return static_cast<int16_t>(v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v));
+	};
+	pos[0] = to_fixed(p.x);
+	pos[1] = to_fixed(p.y);
+}
+
+#else
+
+inline sm::vec2 Painter::Vertex::GetPos() const { return pos; }
+inline void Painter::Vertex::SetPos(const sm::vec2& p) { pos = p; }
+
+#endif // TESS_VERTEX_LAYOUT
+
+inline void swap(Painter& a, Painter& b) noexcept { a.swap(b); }
+
 }
\ No newline at end of file
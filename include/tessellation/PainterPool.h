@@ -0,0 +1,40 @@
+#pragma once
+
+#include "tessellation/Painter.h"
+
+#include <vector>
+
+namespace tess
+{
+
+// Cleared painters handed out again with their capacity, e.g. one per layer and frame.
+// Not thread safe.
+class PainterPool
+{
+public:
+	explicit PainterPool(IndexType index_type = IndexType::UInt16);
+
+	// A recycled painter if there is one, with room for the capacity hint.
+	// It keeps the flags and settings it was released with.
+	Painter Acquire();
+	// painters of another index type are dropped
+	void Release(Painter&& pt);
+
+	// the most vertices and indices of a painter released so far
+	MeshSize GetCapacityHint() const { return m_capacity_hint; }
+
+	size_t GetFreeCount() const { return m_free.size(); }
+
+	// drops the free painters and the hint
+	void Clear();
+
+private:
+	IndexType m_index_type;
+
+	std::vector<Painter> m_free;
+
+	MeshSize m_capacity_hint;
+
+}; // PainterPool
+
+}
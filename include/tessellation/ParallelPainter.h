@@ -0,0 +1,40 @@
+#pragma once
+
+#include "tessellation/Painter.h"
+#include "tessellation/ThreadPool.h"
+
+#include <vector>
+
+namespace tess
+{
+
+struct Shape;
+
+class ParallelPainter
+{
+public:
+	// 0 for one thread per hardware core
+	explicit ParallelPainter(size_t thread_num = 0);
+
+	// Appends the shapes to dst in order, with dst's flags, circle and polyline errors, shape cache and instancing
+	// modes, palette, index type and clip rect. Chunks of shapes are tessellated into painters of their own, then
+	// copied into place with FillPainter() and AddInstances(). A 16-bit dst gets the commands of serial AddShape()
+	// calls, PackPainter() replays the chunks' Reserve() calls on it before FillPacked() copies them. With an output
+	// sink on dst they go through AddPainter() one after the other instead, to land in its chunks.
+	void AddShapes(const Shape* shapes, size_t count, Painter& dst);
+
+private:
+	ThreadPool m_pool;
+
+	// one per chunk, reused to keep their capacity
+	std::vector<Painter> m_chunks;
+
+	std::vector<size_t> m_vtx_offsets, m_idx_offsets, m_cmd_offsets;
+
+	// per chunk, for a 16-bit dst
+	std::vector<PodArray<Painter::Reservation>> m_reservations;
+	std::vector<PodArray<Painter::Placement>>   m_placements;
+
+}; // ParallelPainter
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <new>
+
+namespace tess
+{
+
+// Growable array for trivially copyable types.
+// New elements are left uninitialized, clear() keeps the capacity, a move takes it along.
+template <typename T>
+class PodArray
+{
+public:
+	PodArray() = default;
+	PodArray(const PodArray& arr) {
+		*this = arr;
+	}
+	PodArray& operator = (const PodArray& arr)
+	{
+		if (this != &arr)
+		{
+			m_size = 0;
+			reserve(arr.m_size);
+			if (arr.m_size > 0) {
+				std::memcpy(m_data, arr.m_data, arr.m_size * sizeof(T));
+			}
+			m_size = arr.m_size;
+		}
+		return *this;
+	}
+	PodArray(PodArray&& arr) noexcept {
+		swap(arr);
+	}
+	PodArray& operator = (PodArray&& arr) noexcept
+	{
+		swap(arr);
+		return *this;
+	}
+	~PodArray() {
+		if (m_owned) {
+			std::free(m_data);
+		}
+	}
+
+	T* data() { return m_data; }
+	const T* data() const { return m_data; }
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_capacity; }
+	bool empty() const { return m_size == 0; }
+
+	T* begin() { return m_data; }
+	T* end() { return m_data + m_size; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+	T& operator [] (size_t i) { assert(i < m_size); return m_data[i]; }
+	const T& operator [] (size_t i) const { assert(i < m_size); return m_data[i]; }
+
+	T& front() { assert(m_size > 0); return m_data[0]; }
+	const T& front() const { assert(m_size > 0); return m_data[0]; }
+	T& back() { assert(m_size > 0); return m_data[m_size - 1]; }
+	const T& back() const { assert(m_size > 0); return m_data[m_size - 1]; }
+
+	void clear() { m_size = 0; }
+
+	void resize(size_t size)
+	{
+		if (size > m_capacity) {
+			reserve(GrowCapacity(size));
+		}
+		m_size = size;
+	}
+
+	void reserve(size_t capacity)
+	{
+		if (capacity <= m_capacity) {
+			return;
+		}
+
+		T* data = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+		if (!data) {
+			throw std::bad_alloc();
+		}
+		if (m_size > 0) {
+			std::memcpy(data, m_data, m_size * sizeof(T));
+		}
+		if (m_owned) {
+			std::free(m_data);
+		}
+		m_data = data;
+		m_capacity = capacity;
+		m_owned = true;
+	}
+
+	// empties the array onto memory of the caller, which it keeps until
+	// growing past capacity moves it to a copy of its own
+	void attach(T* data, size_t capacity)
+	{
+		if (m_owned) {
+			std::free(m_data);
+		}
+		m_data = data;
+		m_size = 0;
+		m_capacity = capacity;
+		m_owned = false;
+	}
+
+	// appends count uninitialized elements and returns the first one
+	T* append(size_t count)
+	{
+		const size_t size = m_size + count;
+		if (size > m_capacity) {
+			reserve(GrowCapacity(size));
+		}
+		T* ret = m_data + m_size;
+		m_size = size;
+		return ret;
+	}
+
+	void push_back(const T& val) {
+		*append(1) = val;
+	}
+
+	void swap(PodArray& arr) noexcept
+	{
+		std::swap(m_data, arr.m_data);
+		std::swap(m_size, arr.m_size);
+		std::swap(m_capacity, arr.m_capacity);
+		std::swap(m_owned, arr.m_owned);
+	}
+
+private:
+	size_t GrowCapacity(size_t size) const {
+		return std::max(size, m_capacity ? m_capacity * 2 : 8);
+	}
+
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "PodArray needs a trivially copyable type");
+
+	T*     m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_capacity = 0;
+	bool   m_owned = true;
+
+}; // PodArray
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "tessellation/Painter.h"
+
+#include <vector>
+
+namespace tess
+{
+
+struct Shape;
+
+// Keeps shapes in place between frames: each one owns a slot of vertices and indices
+// in a 32-bit buffer, so updating or removing it only rewrites its own slot.
+class RetainedPainter
+{
+public:
+	using Handle = uint32_t;
+	static const Handle INVALID_HANDLE = 0xffffffff;
+
+	// byte range into GetBuffer().vertices or GetBuffer().indices32
+	struct Range
+	{
+		size_t begin, end;
+	};
+
+public:
+	RetainedPainter();
+
+	Handle Add(const Shape& shape);
+	// rewritten in place when it still fits its slot, moved to the end of the buffer otherwise
+	void Update(Handle handle, const Shape& shape);
+	// the slot's triangles become degenerate, later Add() calls can reuse it
+	void Remove(Handle handle);
+
+	void Clear();
+	// packs the live shapes to the front without their spare room, dirties the whole buffer
+	void Compact();
+
+	// sorted and merged ranges changed since the last call
+	void TakeDirtyRanges(std::vector<Range>& vertex_ranges, std::vector<Range>& index_ranges);
+
+	// for the shapes added or updated from now on
+	void SetFlags(uint32_t flags) { m_tess.SetFlags(flags); }
+	void SetPalette(const std::shared_ptr<Palette>& palette) { m_tess.SetPalette(palette); }
+	void SetCircleMaxError(float max_error) { m_tess.SetCircleMaxError(max_error); }
+
+	auto& GetBuffer() const { return m_buf; }
+
+	// vertices held by removed or moved shapes, until Compact()
+	size_t GetUnusedVertexCount() const { return m_unused_vtx; }
+
+private:
+	struct Slot
+	{
+		size_t vtx_off = 0, vtx_count = 0, vtx_cap = 0;
+		size_t idx_off = 0, idx_count = 0, idx_cap = 0;
+		bool alive = false;
+	};
+
+	// tessellates into m_tess
+	void Tessellate(const Shape& shape);
+
+	bool Fits(const Slot& slot) const;
+	// a new slot at the end of the buffer, sized for m_tess
+	void AppendSlot(Slot& slot);
+	// copies m_tess into the slot, the rest of its indices become degenerate
+	void WriteSlot(Slot& slot);
+	void ClearSlot(const Slot& slot);
+
+	void AddDirty(std::vector<Range>& ranges, size_t begin, size_t end);
+
+private:
+	Painter::Buffer m_buf;
+
+	Painter m_tess;
+
+	std::vector<Slot>   m_slots;
+	std::vector<Handle> m_free;
+
+	size_t m_unused_vtx = 0;
+
+	std::vector<Range> m_dirty_vtx, m_dirty_idx;
+
+}; // RetainedPainter
+
+}
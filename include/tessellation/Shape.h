@@ -0,0 +1,67 @@
+#pragma once
+
+#include "tessellation/Painter.h"
+
+namespace tess
+{
+
+enum class ShapeType
+{
+	Line,
+	DashLine,
+	Rect,
+	RectFilled,
+	Circle,
+	CircleFilled,
+	Arc,
+	Triangle,
+	TriangleFilled,
+	Polyline,
+	PolylineMultiColor,
+	PolylineDash,
+	Polygon,
+	PolygonFilled,
+};
+
+// params of one 2d Painter::Add* call, the point arrays are not owned
+struct Shape
+{
+	ShapeType type = ShapeType::Line;
+
+	// end points, rect corners or triangle, p0 is the centre of circles and arcs
+	sm::vec2 p0, p1, p2;
+
+	uint32_t col = 0;
+	float    line_width = DEFAULT_LINE_WIDTH;
+
+	float    radius = 0;
+	float    start_angle = 0, end_angle = 0;
+	uint32_t num_segments = CIRCLE_SEGMENTS_AUTO;
+
+	float    rounding = 0;
+	uint32_t rounding_corners_flags = CORNER_FLAGS_NONE;
+
+	float    step_len = DEFAULT_DASH_LINE_STEP;
+
+	const sm::vec2* points = nullptr;
+	const uint32_t* cols   = nullptr;
+	size_t          count  = 0;
+
+	static Shape Line(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	static Shape DashLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, float step_len = DEFAULT_DASH_LINE_STEP);
+	static Shape Rect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE);
+	static Shape RectFilled(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding = 0, uint32_t rounding_corners_flags = CORNER_FLAGS_NONE);
+	static Shape Circle(const sm::vec2& centre, float radius, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
+	static Shape CircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
+	static Shape Arc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, uint32_t num_segments = CIRCLE_SEGMENTS_AUTO);
+	static Shape Triangle(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	static Shape TriangleFilled(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col);
+	static Shape Polyline(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	static Shape PolylineMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, float line_width = DEFAULT_LINE_WIDTH);
+	static Shape PolylineDash(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH, float step_len = DEFAULT_DASH_LINE_STEP);
+	static Shape Polygon(const sm::vec2* points, size_t count, uint32_t col, float line_width = DEFAULT_LINE_WIDTH);
+	static Shape PolygonFilled(const sm::vec2* points, size_t count, uint32_t col);
+
+}; // Shape
+
+}
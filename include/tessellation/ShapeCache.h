@@ -0,0 +1,87 @@
+#pragma once
+
+#include "tessellation/PodArray.h"
+
+#include <SM_Vector.h>
+
+#include <unordered_map>
+
+namespace tess
+{
+
+// Tessellated shapes kept by their size params, to be re-emitted at other positions and colors.
+class ShapeCache
+{
+public:
+	enum class Kind : uint32_t
+	{
+		Circle,
+		CircleFilled,
+		Rect,
+		RectFilled,
+	};
+
+	// compared and hashed bitwise, every field is 4 bytes so there is no padding
+	struct Key
+	{
+		Key(Kind kind, uint32_t flags, uint32_t segments, uint32_t corners,
+			const sm::vec2& size, float rounding, float line_width);
+
+		bool operator == (const Key& key) const;
+
+		Kind     kind;
+		uint32_t flags;		// Painter::GetFlags()
+		uint32_t segments;
+		uint32_t corners;	// rounding corner flags
+		float    size[2];	// radius, or rect width and height
+		float    rounding;
+		float    line_width;
+	};
+
+	// valid until the next Insert() or Clear()
+	struct Mesh
+	{
+		sm::vec2* positions = nullptr;	// relative to the shape's origin
+		uint32_t* col_masks = nullptr;	// ANDed with the color, clears the alpha of the AA fringe
+		float*    edges     = nullptr;	// Vertex::uv.x with Painter's ANALYTIC_AA, null for none
+		uint32_t* indices   = nullptr;	// relative to the first vertex
+		size_t vtx_count = 0, idx_count = 0;
+	};
+
+	bool Query(const Key& key, Mesh& mesh);
+	// room for a new mesh to be filled by the caller, the cache starts over when full
+	Mesh Insert(const Key& key, size_t vtx_count, size_t idx_count);
+
+	void Clear();
+
+	size_t Size() const { return m_entries.size(); }
+
+	// bigger shapes are not worth keeping
+	static const size_t MAX_VERTICES = 4096;
+	static const size_t MAX_ENTRIES  = 1024;
+
+private:
+	struct KeyHash
+	{
+		size_t operator () (const Key& key) const;
+	};
+
+	struct Entry
+	{
+		size_t vtx_off, vtx_count;
+		size_t idx_off, idx_count;
+	};
+
+	Mesh MakeMesh(const Entry& entry);
+
+private:
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+
+	PodArray<sm::vec2> m_positions;
+	PodArray<uint32_t> m_col_masks;
+	PodArray<float>    m_edges;
+	PodArray<uint32_t> m_indices;
+
+}; // ShapeCache
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+namespace tess
+{
+
+class ThreadPool
+{
+public:
+	// 0 for one thread per hardware core, the calling thread included
+	explicit ThreadPool(size_t thread_num = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	// threads working in ParallelFor(), the calling thread included
+	size_t GetThreadNum() const { return m_threads.size() + 1; }
+
+	// calls func(i) for each i in [0, count) and returns when all are done
+	void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+	void WorkerLoop(size_t id);
+	void Run(size_t id);
+
+private:
+	// [next, end) of one worker, others steal from it when they run dry
+	struct Range
+	{
+		std::atomic<size_t> next;
+		size_t end = 0;
+
+		// keep the counters of different workers off the same cache line
+		char padding[64 - sizeof(size_t) * 2];
+	};
+
+	std::vector<std::thread> m_threads;
+	std::unique_ptr<Range[]> m_ranges;
+
+	std::mutex              m_mutex;
+	std::condition_variable m_start_cv, m_done_cv;
+	size_t m_generation = 0;
+	size_t m_pending = 0;
+	bool   m_stop = false;
+
+	const std::function<void(size_t)>* m_func = nullptr;
+	std::exception_ptr m_exception;
+
+}; // ThreadPool
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "tessellation/PodArray.h"
+
+#include <SM_Vector.h>
+
+#include <vector>
+#include <cstdint>
+
+namespace tess
+{
+
+enum class FillRule
+{
+	EvenOdd,
+	NonZero,
+};
+
+// Sweep-line triangulation of polygons with holes. The sweep splits the filled area into
+// y-monotone pieces and triangulates each one while it goes, O(n log n) in all: the active
+// edges live in a balanced tree. Contours may touch or nest but not cross each other or
+// themselves, HasCrossings() tells when they did.
+class Triangulator
+{
+public:
+	struct Contour
+	{
+		size_t begin, count;	// into GetPoints()
+
+		// sign of the segment normal (dy, -dx) that points out of the filled area,
+		// 0 when the contour has the same fill on both sides
+		int outside;
+	};
+
+	void Begin();
+	// closed implicitly, repeated and non-finite points are dropped
+	void AddContour(const sm::vec2* points, size_t count);
+	void Triangulate(FillRule rule);
+	// two edges of the last Triangulate() crossed, its triangles are not to be trusted
+	bool HasCrossings() const { return m_crossings; }
+
+	auto& GetPoints() const { return m_points; }
+	auto& GetContours() const { return m_contours; }
+	// triangles into GetPoints()
+	auto& GetIndices() const { return m_indices; }
+
+private:
+	struct Edge
+	{
+		uint32_t top, bot;
+		int      winding;	// of the region on the right
+		bool     inside;	// the region on the right is filled
+		bool     boundary;	// filled on one side only
+
+		// for the left boundary of a filled span: the piece being triangulated and,
+		// after a merge vertex, the piece on its right until the next vertex joins them
+		uint32_t poly, merge_poly;
+	};
+
+	// a y-monotone piece, its untriangulated reflex chain
+	struct Poly
+	{
+		std::vector<uint32_t> stack;
+		int side;	// chain of the stack, SIDE_*
+	};
+
+	bool IsBelow(uint32_t a, uint32_t b) const;
+	bool IsLeftOf(uint32_t v, const Edge& e) const;
+
+	// the contour segment from a to b, which of the two it starts at
+	uint32_t Segment(uint32_t a, uint32_t b) const;
+	// the active edge from top to bot, NONE if missing
+	uint32_t FindEdge(uint32_t top, uint32_t bot) const;
+	// left boundary of the filled span holding the edge, searched left from it, or NONE
+	uint32_t FindSpan(uint32_t edge) const;
+	// sets m_crossings when the edges next to each other cross
+	void CheckCrossing(uint32_t left, uint32_t right);
+
+	// the active edges, a treap ordered left to right with parent links. All edges on the
+	// left of v come before those with v on their left.
+	uint32_t NewEdge(const Edge& e);
+	// first active edge with v on its left, NONE if none
+	uint32_t LowerBound(uint32_t v) const;
+	uint32_t First() const;
+	uint32_t Last() const;
+	uint32_t Prev(uint32_t edge) const;
+	uint32_t Next(uint32_t edge) const;
+	// position from the left
+	uint32_t Rank(uint32_t edge) const;
+	// the new edges l and r at v, l on the left
+	void Insert(uint32_t v, uint32_t l, uint32_t r);
+	void Erase(uint32_t edge);
+	// the tree at t into the edges on the left of v and the others
+	void Split(uint32_t t, uint32_t v, uint32_t& left, uint32_t& right);
+	uint32_t Merge(uint32_t left, uint32_t right);
+	void UpdateSize(uint32_t t);
+
+	void StartVertex(uint32_t v, uint32_t prev, uint32_t next);
+	void EndVertex(uint32_t v, uint32_t prev, uint32_t next);
+	void RegularVertex(uint32_t v, uint32_t top, uint32_t bot);
+
+	// dir is 1 where the contour goes down the edge, -1 up
+	Edge MakeEdge(uint32_t top, uint32_t bot, int left_winding, int dir) const;
+	void SetContourOutside(const Edge& e, int dir);
+
+	// a regular vertex on one side of the span
+	void AddToSpan(Edge& span, uint32_t v, int side);
+
+	uint32_t NewPoly(uint32_t v);
+	void AddVertex(uint32_t poly, uint32_t v, int side);
+	void ClosePoly(uint32_t poly, uint32_t v);
+
+	bool IsInside(int winding) const;
+
+	static const int SIDE_NONE  = 0;
+	static const int SIDE_LEFT  = 1;
+	static const int SIDE_RIGHT = 2;
+
+	static const uint32_t NONE = 0xffffffff;
+
+private:
+	FillRule m_rule = FillRule::EvenOdd;
+
+	PodArray<sm::vec2> m_points;
+	PodArray<uint32_t> m_point_contours;
+	std::vector<Contour> m_contours;
+
+	PodArray<uint32_t> m_order;
+
+	struct Node
+	{
+		uint32_t left, right, parent;
+		uint32_t size;		// of the subtree
+		uint32_t priority;	// above those of the children
+	};
+
+	// by edge id, the ids of removed edges are reused
+	std::vector<Edge>  m_edges;
+	PodArray<Node>     m_nodes;
+	PodArray<uint32_t> m_free_edges;
+	uint32_t m_root = NONE;
+	uint32_t m_seed = 1;
+	// active edge of each contour segment, by its first point
+	PodArray<uint32_t> m_segment_edges;
+
+	bool m_crossings = false;
+
+	// kept with their stacks' capacity between calls
+	std::vector<Poly>     m_polys;
+	std::vector<uint32_t> m_free_polys;
+
+	PodArray<uint32_t> m_indices;
+
+}; // Triangulator
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "tessellation/PodArray.h"
+
+#include <cstdint>
+
+namespace tess
+{
+
+// Triangle order for a post-transform vertex cache, after Tom Forsyth's linear-speed
+// vertex cache optimisation: the next triangle is the best scored one around the
+// vertices last used, favouring those with few triangles left.
+class VertexCacheOptimizer
+{
+public:
+	// in place, every index below vtx_count
+	void Optimize(uint32_t* indices, size_t idx_count, size_t vtx_count);
+
+	// average post-transform cache misses per triangle of a FIFO cache of that size
+	static float CalcACMR(const uint32_t* indices, size_t idx_count, size_t vtx_count, size_t cache_size = 16);
+
+	// of the modelled LRU cache
+	static const size_t CACHE_SIZE = 32;
+
+private:
+	float CalcVertexScore(uint32_t vertex) const;
+	// a vertex's triangles not emitted yet are the first valence of its corners
+	void RemoveCorner(uint32_t corner, uint32_t vertex);
+
+	static const uint32_t NONE = 0xffffffff;
+
+private:
+	PodArray<uint32_t> m_valence;
+	PodArray<uint32_t> m_tri_offsets;	// into m_vtx_corners, by vertex
+	PodArray<uint32_t> m_vtx_corners;	// t * 3 + k of the triangles around each vertex
+	PodArray<uint32_t> m_corner_slots;	// where each corner is in m_vtx_corners
+	PodArray<int32_t>  m_cache_pos;		// -1 out of the cache
+	PodArray<float>    m_vtx_score;
+
+	PodArray<float>    m_tri_score;
+	PodArray<uint8_t>  m_emitted;
+	PodArray<uint32_t> m_out;
+
+	PodArray<uint32_t> m_cache, m_next_cache;
+
+}; // VertexCacheOptimizer
+
+}
@@ -0,0 +1,48 @@
+#include "tessellation/OutputSink.h"
+
+#include <algorithm>
+
+namespace tess
+{
+
+MemorySink::MemorySink(size_t vtx_capacity, size_t idx_capacity)
+{
+	m_vertices.reserve(vtx_capacity);
+	m_indices.reserve(idx_capacity);
+	m_indices32.reserve(idx_capacity);
+}
+
+OutputSink::Chunk MemorySink::Acquire(IndexType index_type)
+{
+	Chunk chunk;
+	chunk.vertices     = m_vertices.data();
+	chunk.vtx_capacity = m_vertices.capacity();
+	if (index_type == IndexType::UInt32) {
+		chunk.indices      = m_indices32.data();
+		chunk.idx_capacity = m_indices32.capacity();
+	} else {
+		chunk.indices      = m_indices.data();
+		chunk.idx_capacity = m_indices.capacity();
+	}
+	return chunk;
+}
+
+void MemorySink::Flush(const Painter::Buffer& buf)
+{
+	m_batches.push_back(Batch());
+	auto& batch = m_batches.back();
+	batch.commands = buf.commands;
+
+	const size_t vtx_count = buf.vertices.size();
+	std::copy(buf.vertices.begin(), buf.vertices.end(), batch.vertices.append(vtx_count));
+
+	const size_t idx_count = buf.IndexCount();
+	uint32_t* dst = batch.indices.append(idx_count);
+	if (buf.index_type == IndexType::UInt32) {
+		std::copy(buf.indices32.begin(), buf.indices32.end(), dst);
+	} else {
+		std::copy(buf.indices.begin(), buf.indices.end(), dst);
+	}
+}
+
+}
@@ -1,798 +1,3399 @@
 #include "tessellation/Painter.h"
 #include "tessellation/Palette.h"
+#include "tessellation/Shape.h"
+#include "tessellation/OutputSink.h"
+#include "tessellation/VertexCacheOptimizer.h"
 
 #include <SM_Calc.h>
 #include <primitive/Path.h>
 
 #include <array>
 #include <iterator>
+#include <algorithm>
 #include <cmath>
+#include <cfloat>
+#include <cassert>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+// TESS_NO_SIMD builds the scalar kernels only, the reference of bench/simd_check.cpp
+#ifndef TESS_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TESS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#define TESS_SIMD_AVX
+#include <immintrin.h>
+#endif
+#endif // TESS_NO_SIMD
+
+#if TESS_ENABLE_STATS
+#include <chrono>
+#define TESS_STATS_SCOPE(kind) StatsScope stats_scope(*this, StatsKind::kind)
+#else
+#define TESS_STATS_SCOPE(kind)
+#endif // TESS_ENABLE_STATS
 
 namespace
 {
 const uint32_t COL32_A_MASK = 0xFF000000;
-}
 
-namespace tess
+bool is_same_rect(const sm::rect& r0, const sm::rect& r1)
 {
+	return r0.xmin == r1.xmin && r0.ymin == r1.ymin
+		&& r0.xmax == r1.xmax && r0.ymax == r1.ymax;
+}
 
-Painter::Painter(const Painter& pt)
-	: m_flags(pt.m_flags)
-	, m_buf(pt.m_buf)
-	, m_other_texs(pt.m_other_texs)
-	, m_palette(pt.m_palette)
+bool is_same_state(const tess::Painter::Cmd& c0, const tess::Painter::Cmd& c1)
 {
+	return c0.texid == c1.texid && is_same_rect(c0.clip_rect, c1.clip_rect);
 }
 
-Painter& Painter::operator = (const Painter& pt)
+// the kernels below read sm::vec2 arrays as packed x, y floats
+static_assert(sizeof(sm::vec2) == sizeof(float) * 2, "sm::vec2 is not two packed floats");
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+static_assert(sizeof(tess::Painter::Vertex) == 20, "unexpected vertex size");
+static_assert(offsetof(tess::Painter::Vertex, uv) == offsetof(tess::Painter::Vertex, pos) + sizeof(sm::vec2), "uv does not follow pos");
+#elif TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_COL
+static_assert(sizeof(tess::Painter::Vertex) == 12, "unexpected vertex size");
+#elif TESS_VERTEX_LAYOUT == TESS_VERTEX_POS16_COL
+static_assert(sizeof(tess::Painter::Vertex) == 8, "unexpected vertex size");
+#else
+#error "unknown TESS_VERTEX_LAYOUT"
+#endif
+
+const float MITER_MIN_LEN_SQ = 0.000001f;
+const float MITER_MAX_SCALE  = 100.0f;
+// the longest miter normal, sqrt(MITER_MAX_SCALE)
+const float MITER_MAX_LEN    = 10.0f;
+
+// farthest the vertices of a stroke get from its points, with the spikes of sharp joins
+inline float stroke_margin(float line_width)
 {
-	m_flags      = pt.m_flags;
-	m_buf        = pt.m_buf;
-	m_other_texs = pt.m_other_texs;
-	m_palette    = pt.m_palette;
-	return *this;
+	return MITER_MAX_LEN * (std::max(line_width, 1.0f) * 0.5f + 1.0f);
 }
 
-void Painter::AddLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width)
+// the same for the AA fringe of a fill
+const float FILL_MARGIN = MITER_MAX_LEN * 0.5f;
+
+void calc_bounds(const sm::vec2* points, size_t count, sm::vec2& min, sm::vec2& max)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	min = max = points[0];
+	for (size_t i = 1; i < count; ++i)
+	{
+		min.x = std::min(min.x, points[i].x);
+		min.y = std::min(min.y, points[i].y);
+		max.x = std::max(max.x, points[i].x);
+		max.y = std::max(max.y, points[i].y);
 	}
-
-	sm::vec2 pts[] = { p0, p1 };
-	Stroke(pts, 2, col, false, line_width);
 }
 
-void Painter::AddDashLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float step_len)
+void calc_bounds(const prim::Path& path, sm::vec2& min, sm::vec2& max)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
-	if (p0 == p1) {
-		return;
-	}
-
-	const float tot_len = sm::dis_pos_to_pos(p0, p1);
-	const sm::vec2 dt = (p1 - p0) / tot_len;
-	float len = 0;
-	while (len < tot_len)
+	min = sm::vec2(FLT_MAX, FLT_MAX);
+	max = sm::vec2(-FLT_MAX, -FLT_MAX);
+	auto add = [&](const std::vector<sm::vec2>& points)
 	{
-		const float s = len;
-		const float e = std::min(tot_len, len + step_len);
-		sm::vec2 pts[] = { dt * s, dt * e };
-		Stroke(pts, 2, col, false, line_width);
-		len += step_len * 2;
+		if (points.empty()) {
+			return;
+		}
+		sm::vec2 p_min, p_max;
+		calc_bounds(points.data(), points.size(), p_min, p_max);
+		min.x = std::min(min.x, p_min.x);
+		min.y = std::min(min.y, p_min.y);
+		max.x = std::max(max.x, p_max.x);
+		max.y = std::max(max.y, p_max.y);
+	};
+	for (auto& sub : path.GetPrevPaths()) {
+		add(sub.vertices);
 	}
+	add(path.GetCurrPath());
 }
 
-void Painter::AddRect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float rounding, uint32_t rounding_corners_flags)
+sm::vec2 calc_segment_normal(const sm::vec2& p0, const sm::vec2& p1)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
-
-	auto path = PathRect(p0, p1, col, rounding, rounding_corners_flags);
-	Stroke(path, col, line_width);
+	auto diff = p1 - p0;
+	auto inv_len = p0 == p1 ? 1 : 1.0f / sm::dis_pos_to_pos(p0, p1);
+	diff *= inv_len;
+	return sm::vec2(diff.y, -diff.x);
 }
 
-void Painter::AddRectFilled(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+sm::vec2 calc_miter_normal(const sm::vec2& n0, const sm::vec2& n1)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	sm::vec2 dm = (n0 + n1) * 0.5f;
+	float dmr2 = dm.x*dm.x + dm.y*dm.y;
+	if (dmr2 > MITER_MIN_LEN_SQ)
+	{
+		float scale = 1.0f / dmr2;
+		if (scale > MITER_MAX_SCALE) scale = MITER_MAX_SCALE;
+		dm *= scale;
 	}
+	return dm;
+}
 
-	auto path = PathRect(p0, p1, col, rounding, rounding_corners_flags);
-	Fill(path, col);
+#ifdef TESS_SIMD_SSE2
+// two segments, p0 = (x0 y0 x1 y1), p1 = (x1 y1 x2 y2)
+inline __m128 calc_segment_normals_sse(__m128 p0, __m128 p1)
+{
+	const __m128 d    = _mm_sub_ps(p1, p0);
+	const __m128 sq   = _mm_mul_ps(d, d);
+	const __m128 len2 = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	const __m128 one  = _mm_set1_ps(1.0f);
+	const __m128 mask = _mm_cmpgt_ps(len2, _mm_setzero_ps());
+	__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+	inv = _mm_or_ps(_mm_and_ps(mask, inv), _mm_andnot_ps(mask, one));
+	// (dy, -dx)
+	const __m128 sign = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+	return _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)), _mm_mul_ps(inv, sign));
 }
 
-void Painter::AddRectFilled(const sm::vec2& center, float radius, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+inline __m128 calc_miter_normals_sse(__m128 n0, __m128 n1)
 {
-    AddRectFilled(sm::vec2(center.x - radius, center.y - radius), sm::vec2(center.x + radius, center.y + radius), col, rounding, rounding_corners_flags);
+	const __m128 dm    = _mm_mul_ps(_mm_add_ps(n0, n1), _mm_set1_ps(0.5f));
+	const __m128 sq    = _mm_mul_ps(dm, dm);
+	const __m128 dmr2  = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 mask  = _mm_cmpgt_ps(dmr2, _mm_set1_ps(MITER_MIN_LEN_SQ));
+	const __m128 scale = _mm_min_ps(_mm_div_ps(one, dmr2), _mm_set1_ps(MITER_MAX_SCALE));
+	return _mm_mul_ps(dm, _mm_or_ps(_mm_and_ps(mask, scale), _mm_andnot_ps(mask, one)));
 }
+#endif // TESS_SIMD_SSE2
 
-void Painter::AddCircle(const sm::vec2& centre, float radius, uint32_t col, float line_width, uint32_t num_segments)
+#ifdef TESS_SIMD_AVX
+// four segments, same layout as the sse version in each 128-bit lane
+inline __m256 calc_segment_normals_avx(__m256 p0, __m256 p1)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
+	const __m256 d    = _mm256_sub_ps(p1, p0);
+	const __m256 sq   = _mm256_mul_ps(d, d);
+	const __m256 len2 = _mm256_add_ps(sq, _mm256_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	const __m256 one  = _mm256_set1_ps(1.0f);
+	const __m256 mask = _mm256_cmp_ps(len2, _mm256_setzero_ps(), _CMP_GT_OQ);
+	const __m256 inv  = _mm256_blendv_ps(one, _mm256_div_ps(one, _mm256_sqrt_ps(len2)), mask);
+	const __m256 sign = _mm256_setr_ps(1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f);
+	return _mm256_mul_ps(_mm256_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)), _mm256_mul_ps(inv, sign));
+}
 
-	prim::Path path;
-	path.Arc(centre, radius - 0.5f, 0.0f, SM_PI * 2.0f, num_segments);
-	Stroke(path, col, line_width);
+inline __m256 calc_miter_normals_avx(__m256 n0, __m256 n1)
+{
+	const __m256 dm    = _mm256_mul_ps(_mm256_add_ps(n0, n1), _mm256_set1_ps(0.5f));
+	const __m256 sq    = _mm256_mul_ps(dm, dm);
+	const __m256 dmr2  = _mm256_add_ps(sq, _mm256_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	const __m256 one   = _mm256_set1_ps(1.0f);
+	const __m256 mask  = _mm256_cmp_ps(dmr2, _mm256_set1_ps(MITER_MIN_LEN_SQ), _CMP_GT_OQ);
+	const __m256 scale = _mm256_min_ps(_mm256_div_ps(one, dmr2), _mm256_set1_ps(MITER_MAX_SCALE));
+	return _mm256_mul_ps(dm, _mm256_blendv_ps(one, scale, mask));
 }
+#endif // TESS_SIMD_AVX
 
-void Painter::AddCircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments)
+// normals[i] of segment points[i] -> points[i + 1], for i in [0, count - 1)
+void calc_segment_normals(const sm::vec2* points, size_t count, sm::vec2* normals)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	size_t i = 0;
+#if defined(TESS_SIMD_AVX)
+	const float* src = &points[0].x;
+	float* dst = &normals[0].x;
+	for (; i + 8 < count; i += 8)
+	{
+		_mm256_storeu_ps(dst + i * 2, calc_segment_normals_avx(_mm256_loadu_ps(src + i * 2), _mm256_loadu_ps(src + i * 2 + 2)));
+		_mm256_storeu_ps(dst + i * 2 + 8, calc_segment_normals_avx(_mm256_loadu_ps(src + i * 2 + 8), _mm256_loadu_ps(src + i * 2 + 10)));
+	}
+#elif defined(TESS_SIMD_SSE2)
+	const float* src = &points[0].x;
+	float* dst = &normals[0].x;
+	for (; i + 4 < count; i += 4)
+	{
+		_mm_storeu_ps(dst + i * 2, calc_segment_normals_sse(_mm_loadu_ps(src + i * 2), _mm_loadu_ps(src + i * 2 + 2)));
+		_mm_storeu_ps(dst + i * 2 + 4, calc_segment_normals_sse(_mm_loadu_ps(src + i * 2 + 4), _mm_loadu_ps(src + i * 2 + 6)));
+	}
+#endif
+	for (; i + 1 < count; ++i) {
+		normals[i] = calc_segment_normal(points[i], points[i + 1]);
 	}
-
-	prim::Path path;
-	path.Arc(centre, radius - 0.5f, 0.0f, SM_PI * 2.0f, num_segments);
-	Fill(path, col);
 }
 
-void Painter::AddArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width, uint32_t num_segments)
+// dm[i] averaged from normals[i - 1] and normals[i], for i in [1, count)
+void calc_miter_normals(const sm::vec2* normals, size_t count, sm::vec2* dm)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	size_t i = 1;
+#if defined(TESS_SIMD_AVX)
+	const float* src = &normals[0].x;
+	float* dst = &dm[0].x;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(dst + i * 2, calc_miter_normals_avx(_mm256_loadu_ps(src + i * 2 - 2), _mm256_loadu_ps(src + i * 2)));
+		_mm256_storeu_ps(dst + i * 2 + 8, calc_miter_normals_avx(_mm256_loadu_ps(src + i * 2 + 6), _mm256_loadu_ps(src + i * 2 + 8)));
+	}
+#elif defined(TESS_SIMD_SSE2)
+	const float* src = &normals[0].x;
+	float* dst = &dm[0].x;
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(dst + i * 2, calc_miter_normals_sse(_mm_loadu_ps(src + i * 2 - 2), _mm_loadu_ps(src + i * 2)));
+		_mm_storeu_ps(dst + i * 2 + 4, calc_miter_normals_sse(_mm_loadu_ps(src + i * 2 + 2), _mm_loadu_ps(src + i * 2 + 4)));
+	}
+#endif
+	for (; i < count; ++i) {
+		dm[i] = calc_miter_normal(normals[i - 1], normals[i]);
 	}
-
-	const int num = static_cast<int>(std::ceil(std::abs(start_angle - end_angle) / SM_PI * 2.0f * num_segments));
-
-	prim::Path path;
-	path.Arc(centre, radius - 0.5f, start_angle, end_angle, num);
-	Stroke(path, col, line_width);
 }
 
-void Painter::AddTriangle(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col, float line_width)
+// dst[i] = src[i] + off, the 16-bit ones wrap around
+template <typename Src, typename Dst>
+void rebase_indices(const Src* src, size_t count, uint32_t off, Dst* dst)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = static_cast<Dst>(src[i] + off);
 	}
-
-	prim::Path path;
-	path.MoveTo(p0);
-	path.LineTo(p1);
-	path.LineTo(p2);
-	path.LineTo(p0);
-	Stroke(path, col, line_width);
 }
 
-void Painter::AddTriangleFilled(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col)
+#ifdef TESS_SIMD_SSE2
+void rebase_indices(const unsigned short* src, size_t count, uint32_t off, unsigned short* dst)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	const __m128i o = _mm_set1_epi16(static_cast<short>(off));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), o));
+	}
+	for (; i < count; ++i) {
+		dst[i] = static_cast<unsigned short>(src[i] + off);
 	}
-
-	prim::Path path;
-	path.MoveTo(p0);
-	path.LineTo(p1);
-	path.LineTo(p2);
-	path.LineTo(p0);
-	Fill(path, col);
 }
 
-void Painter::AddPolyline(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+void rebase_indices(const unsigned short* src, size_t count, uint32_t off, uint32_t* dst)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	const __m128i o = _mm_set1_epi32(static_cast<int>(off));
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_unpacklo_epi16(v, zero), o));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(v, zero), o));
+	}
+	for (; i < count; ++i) {
+		dst[i] = src[i] + off;
 	}
-
-	Stroke(points, count, col, false, line_width);
 }
 
-void Painter::AddPolylineMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, float line_width)
+void rebase_indices(const uint32_t* src, size_t count, uint32_t off, uint32_t* dst)
 {
-	StrokeMultiColor(points, cols, count, false, line_width);
+	const __m128i o = _mm_set1_epi32(static_cast<int>(off));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), o));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)), o));
+	}
+	for (; i < count; ++i) {
+		dst[i] = src[i] + off;
+	}
 }
+#endif // TESS_SIMD_SSE2
 
-void Painter::AddPolylineDash(const sm::vec2* points, size_t count, uint32_t col, float line_width, float step_len)
+// count indices of src from begin to the write pointer of dst, plus off
+void append_indices(tess::Painter::Buffer& dst, const tess::Painter::Buffer& src, size_t begin, size_t count, uint32_t off)
 {
-    if ((col & COL32_A_MASK) == 0 || count < 2) {
-        return;
-    }
+	if (dst.index_type == tess::IndexType::UInt32)
+	{
+		if (src.index_type == tess::IndexType::UInt32) {
+			rebase_indices(src.indices32.data() + begin, count, off, dst.index32_ptr);
+		} else {
+			rebase_indices(src.indices.data() + begin, count, off, dst.index32_ptr);
+		}
+		dst.index32_ptr += count;
+	}
+	else
+	{
+		if (src.index_type == tess::IndexType::UInt32) {
+			rebase_indices(src.indices32.data() + begin, count, off, dst.index_ptr);
+		} else {
+			rebase_indices(src.indices.data() + begin, count, off, dst.index_ptr);
+		}
+		dst.index_ptr += count;
+	}
+}
 
-    bool draw = true;
-    std::vector<sm::vec2> buf;
-    buf.push_back(points[0]);
-    float need = step_len;
-    int ptr = 0;
-    float seg_len = sm::dis_pos_to_pos(points[0], points[1]);
-    float seg_len_left = seg_len;
-    while (ptr < static_cast<int>(count) - 1)
-    {
-        if (need <= seg_len_left)
-        {
-            seg_len_left -= need;
-            need = step_len;
-            auto pos = points[ptr + 1] + (points[ptr] - points[ptr + 1]) * (seg_len_left / seg_len);
-            buf.push_back(pos);
-            if (draw) {
-                AddPolyline(buf.data(), buf.size(), col, line_width);
-            }
-            draw = !draw;
-            buf.clear();
-            buf.push_back(pos);
-        }
-        else
-        {
-            buf.push_back(points[ptr + 1]);
-            need -= seg_len_left;
-            ++ptr;
-            seg_len = sm::dis_pos_to_pos(points[ptr], points[ptr + 1]);
-            seg_len_left = seg_len;
-        }
-    }
-    if (draw) {
-        AddPolyline(buf.data(), buf.size(), col, line_width);
-    }
+// uv is dropped by the layouts without it
+inline void write_vertex(tess::Painter::Vertex& v, const sm::vec2& pos, const sm::vec2& uv, uint32_t col)
+{
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+#ifdef TESS_SIMD_SSE2
+	const __m128 p = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&pos)));
+	const __m128 t = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&uv)));
+	_mm_storeu_ps(&v.pos.x, _mm_movelh_ps(p, t));
+#else
+	v.pos = pos;
+	v.uv  = uv;
+#endif // TESS_SIMD_SSE2
+#else
+	(void)uv;
+	v.SetPos(pos);
+#endif // TESS_VERTEX_LAYOUT
+	v.col = col;
 }
 
-void Painter::AddPolygon(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+// the edge distance of ANALYTIC_AA lives in Vertex::uv, the other layouts keep the fringe
+inline bool is_analytic_aa(uint32_t flags)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	return (flags & tess::ANALYTIC_AA) != 0;
+#else
+	(void)flags;
+	return false;
+#endif // TESS_VERTEX_LAYOUT
+}
 
-	Stroke(points, count, col, true, line_width);
+inline float read_edge(const tess::Painter::Vertex& v)
+{
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+	return v.uv.x;
+#else
+	(void)v;
+	return 0;
+#endif // TESS_VERTEX_LAYOUT
 }
 
-void Painter::AddPolygonFilled(const sm::vec2* points, size_t count, uint32_t col)
+// max points of an open polyline stroked into one 16-bit draw command
+size_t stroke_run_max_count(uint32_t flags, float line_width)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	size_t vtx_per_point = 4;
+	if (flags & tess::ANTI_ALIASED_LINES) {
+		vtx_per_point = is_analytic_aa(flags) ? 2 : (line_width > 1.0f ? 4 : 3);
 	}
+	return tess::Painter::Buffer::MAX_VERTICES_16 / vtx_per_point;
+}
 
-	Fill(points, count, col);
+// max points of a convex fill in one 16-bit draw command, bigger ones are cut into fans sharing their cut edges
+size_t fill_piece_max_count(uint32_t flags)
+{
+	const bool fringe = (flags & tess::ANTI_ALIASED_FILL) && !is_analytic_aa(flags);
+	return tess::Painter::Buffer::MAX_VERTICES_16 / (fringe ? 2 : 1);
 }
 
-void Painter::AddPath(const prim::Path& path, uint32_t col, float line_width)
+const uint32_t NO_VERTEX = 0xffffffff;
+
+// Cuts triangles into runs of at most MAX_VERTICES_16 vertices, for 16-bit draw commands. remap is
+// NO_VERTEX for every vertex, emit(begin, end, vtx_count) finds the run's vertex of each index in it.
+template <typename Emit>
+void split_triangles(const uint32_t* indices, size_t idx_count, uint32_t* remap, Emit emit)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
+	size_t begin = 0;
+	while (begin < idx_count)
+	{
+		// as many whole triangles as fit one command
+		uint32_t vtx_count = 0;
+		size_t end = begin;
+		for (; end < idx_count; end += 3)
+		{
+			const uint32_t* tri = indices + end;
+			uint32_t added = 0;
+			for (int i = 0; i < 3; ++i) {
+				if (remap[tri[i]] == NO_VERTEX) {
+					remap[tri[i]] = vtx_count + added++;
+				}
+			}
+			if (vtx_count + added > tess::Painter::Buffer::MAX_VERTICES_16)
+			{
+				for (int i = 0; i < 3; ++i) {
+					if (remap[tri[i]] != NO_VERTEX && remap[tri[i]] >= vtx_count) {
+						remap[tri[i]] = NO_VERTEX;
+					}
+				}
+				break;
+			}
+			vtx_count += added;
+		}
 
-	Stroke(path, col, line_width);
+		emit(begin, end, vtx_count);
+
+		for (size_t i = begin; i < end; ++i) {
+			remap[indices[i]] = NO_VERTEX;
+		}
+		begin = end;
+	}
 }
 
-void Painter::AddPoint3D(const sm::vec3& p, Trans2dFunc trans, uint32_t col, float size)
+// split_triangles() over each command of a 32-bit buffer, emit(cmd, begin, end, vtx_count) gets
+// ranges of src's index array and finds the vertices at remap + cmd.vtx_offset
+template <typename Emit>
+void split_commands(const tess::Painter::Buffer& src, tess::PodArray<uint32_t>& remap, Emit emit)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	assert(src.index_type == tess::IndexType::UInt32);
+	remap.resize(src.vertices.size());
+	std::fill(remap.begin(), remap.end(), NO_VERTEX);
+	for (auto& cmd : src.commands)
+	{
+		split_triangles(src.indices32.data() + cmd.idx_offset, cmd.elem_count, remap.data() + cmd.vtx_offset,
+			[&](size_t begin, size_t end, uint32_t vtx_count) {
+				emit(cmd, cmd.idx_offset + begin, cmd.idx_offset + end, vtx_count);
+			});
 	}
-
-	AddCircleFilled(trans(p), size, col);
 }
 
-void Painter::AddLine3D(const sm::vec3& p0, const sm::vec3& p1, Trans2dFunc trans, uint32_t col, float line_width)
+// the commands [cmd_begin, cmd_end) of src, one vertex block too big for a chunk of dst's sink,
+// as runs of whole triangles that fill its chunks one after another
+void append_cut(tess::Painter::Buffer& dst, const tess::Painter::Buffer& src, size_t cmd_begin, size_t cmd_end,
+                tess::PodArray<uint32_t>& remap)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	remap.resize(src.vertices.size());
+	std::fill(remap.begin(), remap.end(), NO_VERTEX);
+	for (size_t k = cmd_begin; k < cmd_end; ++k)
+	{
+		auto& cmd = src.commands[k];
+		auto index = [&](size_t i) {
+			return (src.index_type == tess::IndexType::UInt32 ? src.indices32[i] : src.indices[i]) + static_cast<uint32_t>(cmd.vtx_offset);
+		};
+
+		dst.curr_texid     = cmd.texid;
+		dst.curr_clip_rect = cmd.clip_rect;
+		for (size_t begin = cmd.idx_offset, end = begin + cmd.elem_count; begin < end; )
+		{
+			const size_t vtx_room = dst.vertices.capacity() - dst.vertices.size();
+			const size_t idx_room = dst.IndexCapacity() - dst.IndexCount();
+			uint32_t vtx_count = 0;
+			size_t stop = begin;
+			for (; stop < end && stop + 3 - begin <= idx_room; stop += 3)
+			{
+				uint32_t added = 0;
+				for (size_t i = stop; i < stop + 3; ++i) {
+					if (remap[index(i)] == NO_VERTEX) {
+						remap[index(i)] = vtx_count + added++;
+					}
+				}
+				if (vtx_count + added > vtx_room)
+				{
+					for (size_t i = stop; i < stop + 3; ++i) {
+						if (remap[index(i)] != NO_VERTEX && remap[index(i)] >= vtx_count) {
+							remap[index(i)] = NO_VERTEX;
+						}
+					}
+					break;
+				}
+				vtx_count += added;
+			}
+			if (stop == begin)
+			{
+				// not even one more triangle, on to the next chunk
+				dst.Fit(3, 3);
+				assert(dst.vertices.capacity() >= 3 && dst.IndexCapacity() >= 3);
+				continue;
+			}
+
+			dst.Reserve(stop - begin, vtx_count);
+			for (size_t i = begin; i < stop; ++i)
+			{
+				const uint32_t v = index(i);
+				dst.vert_ptr[remap[v]] = src.vertices[v];
+				if (dst.index_type == tess::IndexType::UInt32) {
+					dst.index32_ptr[i - begin] = dst.curr_index + remap[v];
+				} else {
+					dst.index_ptr[i - begin] = static_cast<unsigned short>(dst.curr_index + remap[v]);
+				}
+			}
+			for (size_t i = begin; i < stop; ++i) {
+				remap[index(i)] = NO_VERTEX;
+			}
+			dst.vert_ptr += vtx_count;
+			if (dst.index_type == tess::IndexType::UInt32) {
+				dst.index32_ptr += stop - begin;
+			} else {
+				dst.index_ptr += stop - begin;
+			}
+			dst.curr_index += vtx_count;
+			begin = stop;
+		}
 	}
-
-	sm::vec2 vs[] = { trans(p0), trans(p1) };
-	Stroke(vs, 2, col, false, line_width);
 }
 
-void Painter::AddCube(const sm::cube& cube, Trans2dFunc trans, uint32_t col, float line_width)
+// color sources of the stroke kernels, uniform strokes need no per-point array
+
+struct UniformColor
 {
-	auto& min = cube.min;
-	auto& max = cube.max;
-	std::array<sm::vec3, 8> v3 = {
-		sm::vec3(min[0], min[1], min[2]),
-		sm::vec3(max[0], min[1], min[2]),
-		sm::vec3(max[0], max[1], min[2]),
-		sm::vec3(min[0], max[1], min[2]),
-		sm::vec3(min[0], min[1], max[2]),
-		sm::vec3(max[0], min[1], max[2]),
-		sm::vec3(max[0], max[1], max[2]),
-		sm::vec3(min[0], max[1], max[2])
-	};
+	explicit UniformColor(uint32_t col) : col(col) {}
 
-	std::array<sm::vec2, 8> v2;
-	for (int i = 0; i < 8; ++i) {
-		v2[i] = trans(v3[i]);
-	}
+	uint32_t operator [] (size_t) const { return col; }
+	UniformColor Offset(size_t) const { return *this; }
+	UniformColor Gather(const uint32_t*, size_t, tess::PodArray<uint32_t>&) const { return *this; }
+	UniformColor Closing(size_t, uint32_t*) const { return *this; }
 
-	// bottom
-	AddLine(v2[0], v2[1], col, line_width);
-	AddLine(v2[1], v2[2], col, line_width);
-	AddLine(v2[2], v2[3], col, line_width);
-	AddLine(v2[3], v2[0], col, line_width);
-	// top
-	AddLine(v2[4], v2[5], col, line_width);
-	AddLine(v2[5], v2[6], col, line_width);
-	AddLine(v2[6], v2[7], col, line_width);
-	AddLine(v2[7], v2[4], col, line_width);
-	// middle
-	AddLine(v2[0], v2[4], col, line_width);
-	AddLine(v2[1], v2[5], col, line_width);
-	AddLine(v2[2], v2[6], col, line_width);
-	AddLine(v2[3], v2[7], col, line_width);
-}
+	uint32_t col;
+};
 
-void Painter::AddArc3D(const sm::mat4& mat, float radius, float start_angle, float end_angle,
-	                   Trans2dFunc trans, uint32_t col, float line_width, uint32_t num_segments)
+struct VertexColor
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
+	explicit VertexColor(const uint32_t* cols) : cols(cols) {}
 
-	std::vector<sm::vec2> vertices;
-	vertices.resize(num_segments);
-	for (size_t i = 0; i < num_segments; ++i)
+	uint32_t operator [] (size_t i) const { return cols[i]; }
+	VertexColor Offset(size_t i) const { return VertexColor(cols + i); }
+	// the colors at index into buf
+	VertexColor Gather(const uint32_t* index, size_t count, tess::PodArray<uint32_t>& buf) const
 	{
-		float angle = start_angle + (end_angle - start_angle) * (static_cast<float>(i) / (num_segments - 1));
-		auto pos3 = mat * (sm::mat4::RotatedZ(angle * SM_RAD_TO_DEG) * sm::vec3(radius, 0, 0));
-		vertices[i] = trans(pos3);
+		buf.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			buf[i] = cols[index[i]];
+		}
+		return VertexColor(buf.data());
+	}
+	// the colors of the segment from the last of count points back to the first, into dst[2]
+	VertexColor Closing(size_t count, uint32_t* dst) const
+	{
+		dst[0] = cols[count - 1];
+		dst[1] = cols[0];
+		return VertexColor(dst);
 	}
 
-	Stroke(vertices.data(), vertices.size(), col, false, line_width);
+	const uint32_t* cols;
+};
+
+// clip space transform of the 3d calls, columns of mat.x are the basis vectors
+static_assert(sizeof(sm::vec4) == sizeof(float) * 4, "sm::vec4 is not four packed floats");
+
+inline sm::vec4 transform_point(const sm::mat4& m, const sm::vec3& p)
+{
+	return sm::vec4(
+		m.x[0] * p.x + m.x[4] * p.y + m.x[8]  * p.z + m.x[12],
+		m.x[1] * p.x + m.x[5] * p.y + m.x[9]  * p.z + m.x[13],
+		m.x[2] * p.x + m.x[6] * p.y + m.x[10] * p.z + m.x[14],
+		m.x[3] * p.x + m.x[7] * p.y + m.x[11] * p.z + m.x[15]);
 }
 
-void Painter::AddPolyline3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col, float line_width, bool closed)
+void transform_points(const sm::mat4& m, const sm::vec3* points, size_t count, sm::vec4* dst)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+#ifdef TESS_SIMD_SSE2
+	const __m128 c0 = _mm_loadu_ps(&m.x[0]);
+	const __m128 c1 = _mm_loadu_ps(&m.x[4]);
+	const __m128 c2 = _mm_loadu_ps(&m.x[8]);
+	const __m128 c3 = _mm_loadu_ps(&m.x[12]);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(points[i].x)), _mm_mul_ps(c1, _mm_set1_ps(points[i].y)));
+		const __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(points[i].z)), c3);
+		_mm_storeu_ps(&dst[i].x, _mm_add_ps(xy, zw));
 	}
-
-	std::vector<sm::vec2> vs2;
-	vs2.reserve(count);
+#else
 	for (size_t i = 0; i < count; ++i) {
-		vs2.push_back(trans(points[i]));
+		dst[i] = transform_point(m, points[i]);
 	}
-    if (closed && !vs2.empty()) {
-        vs2.push_back(vs2.front());
-        count += 1;
-    }
-
-	Stroke(vs2.data(), count, col, false, line_width);
+#endif
 }
 
-void Painter::AddPolygon3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col, float line_width)
+inline bool in_front(const sm::vec4& p)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
-	}
-
-	std::vector<sm::vec2> vs2;
-	vs2.reserve(count);
-	for (size_t i = 0; i < count; ++i) {
-		vs2.push_back(trans(points[i]));
-	}
+	return p.z >= -p.w;
+}
 
-	Stroke(vs2.data(), count, col, true, line_width);
+// where a -> b crosses the near plane
+inline sm::vec4 clip_near(const sm::vec4& a, const sm::vec4& b)
+{
+	const float da = a.z + a.w, db = b.z + b.w;
+	const float t = da / (da - db);
+	return sm::vec4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+		a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
 }
 
-void Painter::AddPolygonFilled3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col)
+// false if the segment is behind the near plane
+inline bool clip_segment(sm::vec4& a, sm::vec4& b)
 {
-	if ((col & COL32_A_MASK) == 0) {
-		return;
+	const bool a_in = in_front(a), b_in = in_front(b);
+	if (!a_in && !b_in) {
+		return false;
 	}
-
-	std::vector<sm::vec2> vs2;
-	vs2.reserve(count);
-	for (size_t i = 0; i < count; ++i) {
-		vs2.push_back(trans(points[i]));
+	if (!a_in) {
+		a = clip_near(a, b);
+	} else if (!b_in) {
+		b = clip_near(a, b);
 	}
-
-	Fill(vs2.data(), count, col);
+	return true;
 }
 
-void Painter::AddTexQuad(int tex, const std::array<sm::vec2, 4>& positions, const std::array<sm::vec2, 4>& texcoords, uint32_t color)
+const uint32_t CIRCLE_AUTO_MIN_SEGMENTS = 4;
+const uint32_t CIRCLE_AUTO_MAX_SEGMENTS = 512;
+
+// from imgui: the fewest segments, rounded up to even, keeping the sagitta under max_error
+uint32_t calc_circle_segments(float radius, float max_error)
 {
-	bool merged = false;
-	if (!m_other_texs.empty())
-	{
-		auto& last = m_other_texs.back();
-		if (last.texid == tex && last.end + 1 == m_buf.curr_index) {
-			last.end += 4;
-			merged = true;
-		}
+	if (radius <= max_error) {
+		return CIRCLE_AUTO_MIN_SEGMENTS;
 	}
-	if (!merged) {
-		m_other_texs.push_back({ tex, m_buf.curr_index, m_buf.curr_index + 3 });
+	uint32_t n = static_cast<uint32_t>(std::ceil(SM_PI / std::acos(1.0f - max_error / radius)));
+	n = (n + 1) & ~1u;
+	return std::min(std::max(n, CIRCLE_AUTO_MIN_SEGMENTS), CIRCLE_AUTO_MAX_SEGMENTS);
+}
+
+const uint32_t CIRCLE_TABLE_MAX_SEGMENTS = 512;
+
+// unit circle points at 2 * PI * i / num_segments for i in [0, num_segments],
+// built on first use and shared by all painters. null past CIRCLE_TABLE_MAX_SEGMENTS.
+const sm::vec2* get_circle_table(uint32_t num_segments)
+{
+	if (num_segments == 0 || num_segments > CIRCLE_TABLE_MAX_SEGMENTS) {
+		return nullptr;
 	}
 
-	m_buf.Reserve(6, 4);
+	static std::atomic<const sm::vec2*> tables[CIRCLE_TABLE_MAX_SEGMENTS + 1];
+	static std::unique_ptr<sm::vec2[]> storage[CIRCLE_TABLE_MAX_SEGMENTS + 1];
+	static std::mutex mutex;
 
-	m_buf.index_ptr[0] = m_buf.curr_index;
-	m_buf.index_ptr[1] = m_buf.curr_index + 1;
-	m_buf.index_ptr[2] = m_buf.curr_index + 2;
-	m_buf.index_ptr[3] = m_buf.curr_index;
-	m_buf.index_ptr[4] = m_buf.curr_index + 2;
-	m_buf.index_ptr[5] = m_buf.curr_index + 3;
-	m_buf.index_ptr += 6;
+	auto table = tables[num_segments].load(std::memory_order_acquire);
+	if (table) {
+		return table;
+	}
 
-	for (int i = 0; i < 4; ++i)
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!storage[num_segments])
 	{
-		auto& v = m_buf.vert_ptr[i];
-		v.pos = positions[i];
-		v.uv  = texcoords[i];
-		v.col = color;
+		auto& points = storage[num_segments];
+		points.reset(new sm::vec2[num_segments + 1]);
+		for (uint32_t i = 0; i < num_segments; ++i)
+		{
+			const double a = SM_PI * 2.0 * i / num_segments;
+			points[i] = sm::vec2(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+		}
+		points[num_segments] = points[0];
+		tables[num_segments].store(points.get(), std::memory_order_release);
 	}
-	m_buf.vert_ptr += 4;
-
-	m_buf.curr_index += 4;
+	return storage[num_segments].get();
 }
 
-void Painter::AddPainter(const Painter& pt)
+// num_segments + 1 points from start_angle to end_angle, rotating the first one step by step
+void arc_points(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t num_segments, sm::vec2* dst)
 {
-	auto& buf = pt.GetBuffer();
-	if (buf.indices.empty()) {
-		return;
+	const double step = (static_cast<double>(end_angle) - start_angle) / std::max(num_segments, 1u);
+	const double c = std::cos(step), s = std::sin(step);
+	double x = std::cos(static_cast<double>(start_angle)) * radius,
+	       y = std::sin(static_cast<double>(start_angle)) * radius;
+	for (uint32_t i = 0; i <= num_segments; ++i)
+	{
+		dst[i] = sm::vec2(centre.x + static_cast<float>(x), centre.y + static_cast<float>(y));
+		const double rx = x * c - y * s;
+		y = x * s + y * c;
+		x = rx;
 	}
+}
 
-	const size_t idx_count = buf.indices.size();
-	const size_t vtx_count = buf.vertices.size();
-	m_buf.Reserve(idx_count, vtx_count);
-	auto off_vert = m_buf.curr_index;
-	for (size_t i = 0; i < idx_count; ++i) {
-		*m_buf.index_ptr++ = buf.indices[i] + off_vert;
-	}
-	for (size_t i = 0; i < vtx_count; ++i) {
-		*m_buf.vert_ptr++ = buf.vertices[i];
+// points [first, first + count] of a circle cut in num_segments
+void circle_points(const sm::vec2& centre, float radius, uint32_t num_segments, uint32_t first, uint32_t count, sm::vec2* dst)
+{
+	if (auto table = get_circle_table(num_segments))
+	{
+		for (uint32_t i = 0; i <= count; ++i) {
+			dst[i] = centre + table[first + i] * radius;
+		}
 	}
-	m_buf.curr_index += static_cast<unsigned short>(vtx_count);
-
-	auto off_tex = m_other_texs.size();
-	std::copy(pt.m_other_texs.begin(), pt.m_other_texs.end(), std::back_inserter(m_other_texs));
-	for (int i = off_tex, n = m_other_texs.size(); i < n; ++i) {
-		auto& tex = m_other_texs[i];
-		tex.begin += off_vert;
-		tex.end   += off_vert;
+	else
+	{
+		const float step = SM_PI * 2.0f / num_segments;
+		arc_points(centre, radius, step * first, step * (first + count), count, dst);
 	}
 }
 
-void Painter::FillPainter(const Painter& pt, size_t vert_off, size_t index_off, size_t tex_off)
+// Walks a dash pattern along an open polyline: add(p) for each point of a dash, the corners
+// it turns included, then end(len) with its length. An odd count of lengths repeats twice as
+// in SVG, a pattern without a positive length is one dash over the whole line.
+template <typename Add, typename End>
+void walk_dashes(const sm::vec2* points, size_t count, const float* pattern, size_t pattern_count,
+	             float phase, Add add, End end)
 {
-	auto& buf = pt.GetBuffer();
-	if (buf.indices.empty() || buf.vertices.empty()) {
+	float period = 0;
+	bool valid = pattern_count > 0;
+	for (size_t i = 0; i < pattern_count; ++i)
+	{
+		valid = valid && pattern[i] >= 0 && std::isfinite(pattern[i]);
+		period += pattern[i];
+	}
+	if (pattern_count % 2 == 1) {
+		period *= 2;
+	}
+	if (!valid || !(period > 0) || !std::isfinite(period))
+	{
+		float len = 0;
+		add(points[0]);
+		for (size_t i = 1; i < count; ++i)
+		{
+			len += sm::dis_pos_to_pos(points[i - 1], points[i]);
+			add(points[i]);
+		}
+		end(len);
 		return;
 	}
 
-	auto& tex_region = pt.GetOtherTexRegion();
+	const size_t n = pattern_count % 2 == 1 ? pattern_count * 2 : pattern_count;
+	auto entry = [&](size_t k) { return pattern[k % pattern_count]; };
 
-	const size_t idx_count = buf.indices.size();
-	const size_t vtx_count = buf.vertices.size();
-	const size_t tex_count = tex_region.size();
-	assert(vert_off + vtx_count - 1 < m_buf.vertices.size()
-	    && index_off + idx_count - 1 < m_buf.indices.size()
-	    && (tex_count == 0 || tex_off + tex_count - 1 < m_other_texs.size()));
-	auto start_index = static_cast<unsigned short>(vert_off);
-	for (size_t i = 0; i < idx_count; ++i) {
-		m_buf.indices[index_off + i] = buf.indices[i] + start_index;
-	}
-	for (size_t i = 0; i < vtx_count; ++i) {
-		m_buf.vertices[vert_off + i] = buf.vertices[i];
+	// the entry the phase falls in, and what is left of it
+	float offset = std::fmod(phase, period);
+	if (offset < 0) {
+		offset += period;
 	}
-	for (size_t i = 0; i < tex_count; ++i) {
-		auto& dst = m_other_texs[tex_off + i];
-		dst = tex_region[i];
-		dst.begin += start_index;
-		dst.end += start_index;
+	size_t k = 0;
+	while (offset >= entry(k))
+	{
+		offset -= entry(k);
+		k = (k + 1) % n;
 	}
-}
+	float left = entry(k) - offset;
+	bool on = k % 2 == 0;
 
-bool Painter::IsEmpty() const
+	float dash_len = 0;
+	if (on) {
+		add(points[0]);
+	}
+	for (size_t i = 0; i + 1 < count; ++i)
+	{
+		auto& a = points[i];
+		auto& b = points[i + 1];
+		const float seg_len = sm::dis_pos_to_pos(a, b);
+		float pos = 0;
+		while (seg_len - pos >= left)
+		{
+			pos += left;
+			const sm::vec2 p = seg_len > 0 ? a + (b - a) * (pos / seg_len) : a;
+			add(p);
+			if (on)
+			{
+				end(dash_len + left);
+				dash_len = 0;
+			}
+			on = !on;
+			k = (k + 1) % n;
+			left = entry(k);
+		}
+		left -= seg_len - pos;
+		if (on)
+		{
+			dash_len += seg_len - pos;
+			add(b);
+		}
+	}
+	if (on) {
+		end(dash_len);
+	}
+}
+
+// PathRect() with the same radius on all its corners, or none
+inline bool is_uniform_rounding(float rounding, uint32_t rounding_corners_flags)
+{
+	return rounding <= 0.0f || rounding_corners_flags == tess::CORNER_FLAGS_NONE || rounding_corners_flags == tess::CORNER_FLAGS_ALL;
+}
+
+// 1 for a convex outline going clockwise on screen, -1 counter-clockwise, 0 for the others
+int convex_orientation(const sm::vec2* points, size_t count)
+{
+	int sign = 0;
+	int x_flips = 0, y_flips = 0;
+	float x_dir = 0, y_dir = 0;
+	sm::vec2 first, prev;
+	bool has_prev = false;
+	for (size_t i = 0; i <= count; ++i)
+	{
+		const sm::vec2 e = i < count ? points[(i + 1) % count] - points[i] : first;
+		if (e.x == 0 && e.y == 0) {
+			continue;
+		}
+		if (!has_prev)
+		{
+			first = prev = e;
+			x_dir = e.x;
+			y_dir = e.y;
+			has_prev = true;
+			continue;
+		}
+
+		const float c = prev.x * e.y - prev.y * e.x;
+		if (c != 0)
+		{
+			const int s = c > 0 ? 1 : -1;
+			if (sign != 0 && s != sign) {
+				return 0;
+			}
+			sign = s;
+		}
+
+		// a convex outline turns around once, so x and y go back and forth twice at most
+		if (e.x != 0) {
+			if (x_dir != 0 && (e.x > 0) != (x_dir > 0)) {
+				++x_flips;
+			}
+			x_dir = e.x;
+		}
+		if (e.y != 0) {
+			if (y_dir != 0 && (e.y > 0) != (y_dir > 0)) {
+				++y_flips;
+			}
+			y_dir = e.y;
+		}
+		prev = e;
+	}
+	if (x_flips > 2 || y_flips > 2) {
+		return 0;
+	}
+	return sign < 0 ? -1 : 1;
+}
+
+inline sm::vec2 to_screen(const sm::vec4& p, const tess::Painter::Viewport& vp)
+{
+	const float inv_w = 1.0f / p.w;
+	return sm::vec2(vp.x + (p.x * inv_w * 0.5f + 0.5f) * vp.w,
+		            vp.y + (p.y * inv_w * 0.5f + 0.5f) * vp.h);
+}
+
+}
+
+namespace tess
+{
+
+template <>
+unsigned short*& Painter::Buffer::IndexPtr<unsigned short>() { return index_ptr; }
+template <>
+uint32_t*& Painter::Buffer::IndexPtr<uint32_t>() { return index32_ptr; }
+
+inline bool Painter::IsTransparent(uint32_t col)
+{
+	if ((col & COL32_A_MASK) != 0) {
+		return false;
+	}
+#if TESS_ENABLE_STATS
+	if (m_stats_depth > 0) {
+		++m_stats[m_stats_kind].alpha_rejects;
+	}
+#endif // TESS_ENABLE_STATS
+	return true;
+}
+
+Painter::Painter(IndexType index_type)
+	: m_buf(index_type)
+{
+}
+
+Painter::Painter(const Painter& pt)
+	: m_flags(pt.m_flags)
+	, m_instancing(pt.m_instancing)
+	, m_circle_max_error(pt.m_circle_max_error)
+	, m_polyline_max_error(pt.m_polyline_max_error)
+	, m_buf(pt.m_buf)
+	, m_instances(pt.m_instances)
+	, m_clip_stack(pt.m_clip_stack)
+	, m_palette(pt.m_palette)
+{
+	EnableShapeCache(pt.IsShapeCacheEnabled());
+}
+
+Painter& Painter::operator = (const Painter& pt)
+{
+	m_flags      = pt.m_flags;
+	m_instancing = pt.m_instancing;
+	m_circle_max_error = pt.m_circle_max_error;
+	m_polyline_max_error = pt.m_polyline_max_error;
+	m_buf        = pt.m_buf;
+	m_instances  = pt.m_instances;
+	m_clip_stack = pt.m_clip_stack;
+	m_palette    = pt.m_palette;
+	EnableShapeCache(pt.IsShapeCacheEnabled());
+	return *this;
+}
+
+Painter::Painter(Painter&& pt) noexcept
+{
+	swap(pt);
+}
+
+Painter& Painter::operator = (Painter&& pt) noexcept
+{
+	swap(pt);
+	return *this;
+}
+
+void Painter::swap(Painter& pt) noexcept
+{
+	using std::swap;
+	swap(m_flags, pt.m_flags);
+	swap(m_instancing, pt.m_instancing);
+	swap(m_circle_max_error, pt.m_circle_max_error);
+	swap(m_polyline_max_error, pt.m_polyline_max_error);
+	m_buf.swap(pt.m_buf);
+	swap(m_instances, pt.m_instances);
+	swap(m_clip_stack, pt.m_clip_stack);
+	swap(m_palette, pt.m_palette);
+	m_scratch.swap(pt.m_scratch);
+	m_clip_pos.swap(pt.m_clip_pos);
+	m_points.swap(pt.m_points);
+	swap(m_shape_cache, pt.m_shape_cache);
+	swap(m_triangulator, pt.m_triangulator);
+	m_mesh_col_masks.swap(pt.m_mesh_col_masks);
+	m_mesh_indices.swap(pt.m_mesh_indices);
+	m_mesh_remap.swap(pt.m_mesh_remap);
+	m_dash_points.swap(pt.m_dash_points);
+	m_dash_counts.swap(pt.m_dash_counts);
+	m_lod_index.swap(pt.m_lod_index);
+	m_lod_points.swap(pt.m_lod_points);
+	m_lod_cols.swap(pt.m_lod_cols);
+#if TESS_ENABLE_STATS
+	swap(m_stats, pt.m_stats);
+#endif // TESS_ENABLE_STATS
+}
+
+void Painter::AddLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Line);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	sm::vec2 pts[] = { p0, p1 };
+	if (!IsVisible(pts, 2, stroke_margin(line_width))) {
+		return;
+	}
+
+	Stroke(pts, 2, col, false, line_width);
+}
+
+void Painter::AddDashLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float step_len)
+{
+	TESS_STATS_SCOPE(DashLine);
+	const sm::vec2 points[] = { p0, p1 };
+	const float pattern[] = { step_len };
+	AddPolylineDash(points, 2, pattern, 1, 0, col, line_width);
+}
+
+void Painter::AddRect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float rounding, uint32_t rounding_corners_flags)
+{
+	TESS_STATS_SCOPE(Rect);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 corners[] = { p0, p1 };
+	if (!IsVisible(corners, 2, stroke_margin(line_width))) {
+		return;
+	}
+
+	const ShapeCache::Key key(ShapeCache::Kind::Rect, m_flags, RectCornerSegments(rounding), rounding_corners_flags, p1 - p0, rounding, line_width);
+	if (m_shape_cache && AddCachedShape(key, p0, col)) {
+		return;
+	}
+
+	const size_t vtx_begin = m_buf.TotalVertexCount(), idx_begin = m_buf.TotalIndexCount();
+	const sm::vec2 origin = m_shape_cache ? sm::vec2(0, 0) : p0;
+	const size_t count = PathRect(origin, origin + (p1 - p0), rounding, rounding_corners_flags);
+	Stroke(m_points.data(), count, col, false, line_width);
+	if (m_shape_cache) {
+		CacheShape(key, p0, col, vtx_begin, idx_begin);
+	}
+}
+
+void Painter::AddRectFilled(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+{
+	TESS_STATS_SCOPE(RectFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 corners[] = { p0, p1 };
+	if (!IsVisible(corners, 2, FILL_MARGIN)) {
+		return;
+	}
+
+	if (m_instancing && is_uniform_rounding(rounding, rounding_corners_flags))
+	{
+		const sm::vec2 half_size(std::fabs(p1.x - p0.x) * 0.5f, std::fabs(p1.y - p0.y) * 0.5f);
+		const float r = rounding > 0.0f && rounding_corners_flags != CORNER_FLAGS_NONE ? rounding : 0.0f;
+		AddInstance(InstanceKind::Rect, (p0 + p1) * 0.5f, half_size, r, col);
+		return;
+	}
+
+	const ShapeCache::Key key(ShapeCache::Kind::RectFilled, m_flags, RectCornerSegments(rounding), rounding_corners_flags, p1 - p0, rounding, 0);
+	if (m_shape_cache && AddCachedShape(key, p0, col)) {
+		return;
+	}
+
+	const size_t vtx_begin = m_buf.TotalVertexCount(), idx_begin = m_buf.TotalIndexCount();
+	const sm::vec2 origin = m_shape_cache ? sm::vec2(0, 0) : p0;
+	const size_t count = PathRect(origin, origin + (p1 - p0), rounding, rounding_corners_flags);
+	Fill(m_points.data(), count - 1, col);
+	if (m_shape_cache) {
+		CacheShape(key, p0, col, vtx_begin, idx_begin);
+	}
+}
+
+void Painter::AddRectFilled(const sm::vec2& center, float radius, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+{
+	TESS_STATS_SCOPE(RectFilled);
+    AddRectFilled(sm::vec2(center.x - radius, center.y - radius), sm::vec2(center.x + radius, center.y + radius), col, rounding, rounding_corners_flags);
+}
+
+void Painter::AddCircle(const sm::vec2& centre, float radius, uint32_t col, float line_width, uint32_t num_segments)
+{
+	TESS_STATS_SCOPE(Circle);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 extent(radius, radius);
+	if (!IsVisible(centre - extent, centre + extent, stroke_margin(line_width))) {
+		return;
+	}
+
+	const uint32_t num = CircleSegments(radius, num_segments);
+	const ShapeCache::Key key(ShapeCache::Kind::Circle, m_flags, num, 0, sm::vec2(radius, radius), 0, line_width);
+	if (m_shape_cache && AddCachedShape(key, centre, col)) {
+		return;
+	}
+
+	const size_t vtx_begin = m_buf.TotalVertexCount(), idx_begin = m_buf.TotalIndexCount();
+	const size_t count = PathArc(m_shape_cache ? sm::vec2(0, 0) : centre, radius - 0.5f, 0.0f, SM_PI * 2.0f, num);
+	Stroke(m_points.data(), count, col, false, line_width);
+	if (m_shape_cache) {
+		CacheShape(key, centre, col, vtx_begin, idx_begin);
+	}
+}
+
+void Painter::AddCircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments)
+{
+	TESS_STATS_SCOPE(CircleFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 extent(radius, radius);
+	if (!IsVisible(centre - extent, centre + extent, FILL_MARGIN)) {
+		return;
+	}
+
+	if (m_instancing)
+	{
+		// the outline of the tessellated one, the fringe is outside of it
+		const float r = radius - 0.5f;
+		AddInstance(InstanceKind::Circle, centre, sm::vec2(r, r), r, col);
+		return;
+	}
+
+	const uint32_t num = CircleSegments(radius, num_segments);
+	const ShapeCache::Key key(ShapeCache::Kind::CircleFilled, m_flags, num, 0, sm::vec2(radius, radius), 0, 0);
+	if (m_shape_cache && AddCachedShape(key, centre, col)) {
+		return;
+	}
+
+	const size_t vtx_begin = m_buf.TotalVertexCount(), idx_begin = m_buf.TotalIndexCount();
+	const size_t count = PathArc(m_shape_cache ? sm::vec2(0, 0) : centre, radius - 0.5f, 0.0f, SM_PI * 2.0f, num);
+	Fill(m_points.data(), count - 1, col);
+	if (m_shape_cache) {
+		CacheShape(key, centre, col, vtx_begin, idx_begin);
+	}
+}
+
+void Painter::AddArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width, uint32_t num_segments)
+{
+	TESS_STATS_SCOPE(Arc);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 extent(radius, radius);
+	if (!IsVisible(centre - extent, centre + extent, stroke_margin(line_width))) {
+		return;
+	}
+
+	const uint32_t num = ArcSegments(radius, start_angle, end_angle, num_segments);
+	const size_t count = PathArc(centre, radius - 0.5f, start_angle, end_angle, num);
+	Stroke(m_points.data(), count, col, false, line_width);
+}
+
+void Painter::AddTriangle(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Triangle);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 points[] = { p0, p1, p2 };
+	if (!IsVisible(points, 3, stroke_margin(line_width))) {
+		return;
+	}
+
+	prim::Path path;
+	path.MoveTo(p0);
+	path.LineTo(p1);
+	path.LineTo(p2);
+	path.LineTo(p0);
+	Stroke(path, col, line_width);
+}
+
+void Painter::AddTriangleFilled(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col)
+{
+	TESS_STATS_SCOPE(TriangleFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const sm::vec2 points[] = { p0, p1, p2 };
+	if (!IsVisible(points, 3, FILL_MARGIN)) {
+		return;
+	}
+
+	FillPolygon(points, 3, col);
+}
+
+void Painter::AddPolyline(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Polyline);
+	if (IsTransparent(col) || count < 2) {
+		return;
+	}
+
+	StrokeVisible(points, UniformColor(col), count, line_width);
+}
+
+void Painter::AddPolylineMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, float line_width)
+{
+	TESS_STATS_SCOPE(Polyline);
+	if (count < 2) {
+		return;
+	}
+
+	StrokeVisible(points, VertexColor(cols), count, line_width);
+}
+
+void Painter::AddPolylineDash(const sm::vec2* points, size_t count, uint32_t col, float line_width, float step_len)
+{
+	TESS_STATS_SCOPE(PolylineDash);
+	const float pattern[] = { step_len };
+	AddPolylineDash(points, count, pattern, 1, 0, col, line_width);
+}
+
+void Painter::AddPolylineDash(const sm::vec2* points, size_t count, const float* pattern, size_t pattern_count,
+	                          float phase, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(PolylineDash);
+	if (IsTransparent(col) || count < 2) {
+		return;
+	}
+	const float margin = stroke_margin(line_width);
+	if (!IsVisible(points, count, margin)) {
+		return;
+	}
+
+	// all the dashes first, one after another, so the buffer grows once
+	m_dash_points.clear();
+	m_dash_counts.clear();
+	uint32_t dash_begin = 0;
+	walk_dashes(points, count, pattern, pattern_count, phase,
+		[&](const sm::vec2& p) { m_dash_points.push_back(p); },
+		[&](float len)
+		{
+			const uint32_t end = static_cast<uint32_t>(m_dash_points.size());
+			if (len > 0) {
+				m_dash_counts.push_back(end - dash_begin);
+			} else {
+				m_dash_points.resize(dash_begin);
+			}
+			dash_begin = static_cast<uint32_t>(m_dash_points.size());
+		});
+
+	MeshSize sz;
+	for (auto n : m_dash_counts) {
+		sz += CalcStrokeSize(n, false, line_width);
+	}
+	m_buf.Preallocate(sz.idx_count, sz.vtx_count);
+
+	const sm::vec2* dash = m_dash_points.data();
+	for (auto n : m_dash_counts)
+	{
+		if (IsVisible(dash, n, margin)) {
+			StrokeImpl(dash, UniformColor(col), n, false, line_width);
+		}
+		dash += n;
+	}
+}
+
+void Painter::AddPolygon(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Polygon);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	if (count < 2 || !IsVisible(points, count, stroke_margin(line_width))) {
+		return;
+	}
+
+	Stroke(points, count, col, true, line_width);
+}
+
+void Painter::AddPolygonFilled(const sm::vec2* points, size_t count, uint32_t col)
+{
+	TESS_STATS_SCOPE(PolygonFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+	if (count < 3 || !IsVisible(points, count, FILL_MARGIN)) {
+		return;
+	}
+
+	FillPolygon(points, count, col);
+}
+
+void Painter::AddPolygonFilled(const sm::vec2* points, const size_t* counts, size_t contour_count, uint32_t col, FillRule rule)
+{
+	TESS_STATS_SCOPE(PolygonFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	size_t total = 0;
+	for (size_t i = 0; i < contour_count; ++i) {
+		total += counts[i];
+	}
+	if (total == 0 || !IsVisible(points, total, FILL_MARGIN)) {
+		return;
+	}
+
+	m_triangulator.Begin();
+	for (size_t i = 0; i < contour_count; ++i)
+	{
+		m_triangulator.AddContour(points, counts[i]);
+		points += counts[i];
+	}
+	m_triangulator.Triangulate(rule);
+	FillTriangulated(col);
+}
+
+void Painter::AddPath(const prim::Path& path, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Path);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	sm::vec2 min, max;
+	calc_bounds(path, min, max);
+	if (!IsVisible(min, max, stroke_margin(line_width))) {
+		return;
+	}
+
+	Stroke(path, col, line_width);
+}
+
+void Painter::AddPathFilled(const prim::Path& path, uint32_t col, FillRule rule)
+{
+	TESS_STATS_SCOPE(PathFilled);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	sm::vec2 min, max;
+	calc_bounds(path, min, max);
+	if (!IsVisible(min, max, FILL_MARGIN)) {
+		return;
+	}
+
+	Fill(path, col, rule);
+}
+
+void Painter::AddPoint3D(const sm::vec3& p, Trans2dFunc trans, uint32_t col, float size)
+{
+	TESS_STATS_SCOPE(Point3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	AddCircleFilled(trans(p), size, col);
+}
+
+void Painter::AddLine3D(const sm::vec3& p0, const sm::vec3& p1, Trans2dFunc trans, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Line3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	sm::vec2 vs[] = { trans(p0), trans(p1) };
+	Stroke(vs, 2, col, false, line_width);
+}
+
+void Painter::AddCube(const sm::cube& cube, Trans2dFunc trans, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Cube);
+	auto& min = cube.min;
+	auto& max = cube.max;
+	std::array<sm::vec3, 8> v3 = {
+		sm::vec3(min[0], min[1], min[2]),
+		sm::vec3(max[0], min[1], min[2]),
+		sm::vec3(max[0], max[1], min[2]),
+		sm::vec3(min[0], max[1], min[2]),
+		sm::vec3(min[0], min[1], max[2]),
+		sm::vec3(max[0], min[1], max[2]),
+		sm::vec3(max[0], max[1], max[2]),
+		sm::vec3(min[0], max[1], max[2])
+	};
+
+	std::array<sm::vec2, 8> v2;
+	for (int i = 0; i < 8; ++i) {
+		v2[i] = trans(v3[i]);
+	}
+
+	// bottom
+	AddLine(v2[0], v2[1], col, line_width);
+	AddLine(v2[1], v2[2], col, line_width);
+	AddLine(v2[2], v2[3], col, line_width);
+	AddLine(v2[3], v2[0], col, line_width);
+	// top
+	AddLine(v2[4], v2[5], col, line_width);
+	AddLine(v2[5], v2[6], col, line_width);
+	AddLine(v2[6], v2[7], col, line_width);
+	AddLine(v2[7], v2[4], col, line_width);
+	// middle
+	AddLine(v2[0], v2[4], col, line_width);
+	AddLine(v2[1], v2[5], col, line_width);
+	AddLine(v2[2], v2[6], col, line_width);
+	AddLine(v2[3], v2[7], col, line_width);
+}
+
+void Painter::AddArc3D(const sm::mat4& mat, float radius, float start_angle, float end_angle,
+	                   Trans2dFunc trans, uint32_t col, float line_width, uint32_t num_segments)
+{
+	TESS_STATS_SCOPE(Arc3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	m_points.resize(num_segments);
+	for (size_t i = 0; i < num_segments; ++i)
+	{
+		float angle = start_angle + (end_angle - start_angle) * (static_cast<float>(i) / (num_segments - 1));
+		auto pos3 = mat * (sm::mat4::RotatedZ(angle * SM_RAD_TO_DEG) * sm::vec3(radius, 0, 0));
+		m_points[i] = trans(pos3);
+	}
+
+	Stroke(m_points.data(), num_segments, col, false, line_width);
+}
+
+void Painter::AddPolyline3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col, float line_width, bool closed)
+{
+	TESS_STATS_SCOPE(Polyline3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	const bool close = closed && count > 0;
+	m_points.resize(close ? count + 1 : count);
+	for (size_t i = 0; i < count; ++i) {
+		m_points[i] = trans(points[i]);
+	}
+	if (close) {
+		m_points[count++] = m_points[0];
+	}
+
+	StrokeSimplified(m_points.data(), UniformColor(col), count, false, line_width);
+}
+
+void Painter::AddPolygon3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Polygon3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	m_points.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		m_points[i] = trans(points[i]);
+	}
+
+	Stroke(m_points.data(), count, col, true, line_width);
+}
+
+void Painter::AddPolygonFilled3D(const sm::vec3* points, size_t count, Trans2dFunc trans, uint32_t col)
+{
+	TESS_STATS_SCOPE(PolygonFilled3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	m_points.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		m_points[i] = trans(points[i]);
+	}
+
+	FillPolygon(m_points.data(), count, col);
+}
+
+void Painter::AddPoint3D(const sm::vec3& p, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float size)
+{
+	TESS_STATS_SCOPE(Point3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	auto cp = transform_point(view_proj, p);
+	if (in_front(cp)) {
+		AddCircleFilled(to_screen(cp, vp), size, col);
+	}
+}
+
+void Painter::AddLine3D(const sm::vec3& p0, const sm::vec3& p1, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Line3D);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	auto c0 = transform_point(view_proj, p0);
+	auto c1 = transform_point(view_proj, p1);
+	if (clip_segment(c0, c1))
+	{
+		sm::vec2 vs[] = { to_screen(c0, vp), to_screen(c1, vp) };
+		Stroke(vs, 2, col, false, line_width);
+	}
+}
+
+void Painter::AddCube(const sm::cube& cube, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Cube);
+	if (IsTransparent(col)) {
+		return;
+	}
+
+	auto& min = cube.min;
+	auto& max = cube.max;
+	const sm::vec3 v3[] = {
+		sm::vec3(min[0], min[1], min[2]),
+		sm::vec3(max[0], min[1], min[2]),
+		sm::vec3(max[0], max[1], min[2]),
+		sm::vec3(min[0], max[1], min[2]),
+		sm::vec3(min[0], min[1], max[2]),
+		sm::vec3(max[0], min[1], max[2]),
+		sm::vec3(max[0], max[1], max[2]),
+		sm::vec3(min[0], max[1], max[2])
+	};
+	sm::vec4 v4[8];
+	transform_points(view_proj, v3, 8, v4);
+
+	static const int EDGES[12][2] = {
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },	// bottom
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },	// top
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }	// middle
+	};
+	for (auto& e : EDGES)
+	{
+		auto c0 = v4[e[0]], c1 = v4[e[1]];
+		if (clip_segment(c0, c1))
+		{
+			sm::vec2 vs[] = { to_screen(c0, vp), to_screen(c1, vp) };
+			Stroke(vs, 2, col, false, line_width);
+		}
+	}
+}
+
+void Painter::AddArc3D(const sm::mat4& mat, float radius, float start_angle, float end_angle, const sm::mat4& view_proj, const Viewport& vp,
+	                   uint32_t col, float line_width, uint32_t num_segments)
+{
+	TESS_STATS_SCOPE(Arc3D);
+	if (IsTransparent(col) || num_segments < 2) {
+		return;
+	}
+
+	const sm::mat4 mvp = view_proj * mat;
+	m_clip_pos.resize(num_segments);
+	for (size_t i = 0; i < num_segments; ++i)
+	{
+		float angle = start_angle + (end_angle - start_angle) * (static_cast<float>(i) / (num_segments - 1));
+		m_clip_pos[i] = transform_point(mvp, sm::vec3(radius * std::cos(angle), radius * std::sin(angle), 0));
+	}
+
+	StrokeClipped(num_segments, vp, col, false, line_width);
+}
+
+void Painter::AddPolyline3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width, bool closed)
+{
+	TESS_STATS_SCOPE(Polyline3D);
+	if (IsTransparent(col) || count < 2) {
+		return;
+	}
+
+	m_clip_pos.resize(count);
+	transform_points(view_proj, points, count, m_clip_pos.data());
+	StrokeClipped(count, vp, col, closed, line_width);
+}
+
+void Painter::AddPolygon3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col, float line_width)
+{
+	TESS_STATS_SCOPE(Polygon3D);
+	AddPolyline3D(points, count, view_proj, vp, col, line_width, true);
+}
+
+void Painter::AddPolygonFilled3D(const sm::vec3* points, size_t count, const sm::mat4& view_proj, const Viewport& vp, uint32_t col)
+{
+	TESS_STATS_SCOPE(PolygonFilled3D);
+	if (IsTransparent(col) || count < 3) {
+		return;
+	}
+
+	m_clip_pos.resize(count);
+	transform_points(view_proj, points, count, m_clip_pos.data());
+	FillClipped(count, vp, col);
+}
+
+bool Painter::AddCachedShape(const ShapeCache::Key& key, const sm::vec2& pos, uint32_t col)
+{
+	ShapeCache::Mesh mesh;
+	if (!m_shape_cache->Query(key, mesh)) {
+		return false;
+	}
+
+	AddMesh(mesh, pos, col);
+	return true;
+}
+
+void Painter::AddMesh(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col)
+{
+	if (mesh.vtx_count == 0) {
+		return;
+	}
+
+	if (m_buf.index_type == IndexType::UInt32) {
+		AddMeshImpl<uint32_t>(mesh, pos, col);
+	} else if (mesh.vtx_count <= Buffer::MAX_VERTICES_16) {
+		AddMeshImpl<unsigned short>(mesh, pos, col);
+	} else {
+		AddMeshSplit(mesh, pos, col);
+	}
+}
+
+template <typename Index>
+void Painter::AddMeshImpl(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col)
+{
+	const auto uv = PaletteUV();
+	const float* edges = is_analytic_aa(m_flags) ? mesh.edges : nullptr;
+	m_buf.Reserve(mesh.idx_count, mesh.vtx_count);
+
+	for (size_t i = 0; i < mesh.vtx_count; ++i) {
+		write_vertex(m_buf.vert_ptr[i], mesh.positions[i] + pos, edges ? sm::vec2(edges[i], 0) : uv, col & mesh.col_masks[i]);
+	}
+	m_buf.vert_ptr += mesh.vtx_count;
+
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+	for (size_t i = 0; i < mesh.idx_count; ++i) {
+		index_ptr[i] = static_cast<Index>(m_buf.curr_index + mesh.indices[i]);
+	}
+	index_ptr += mesh.idx_count;
+
+	m_buf.curr_index += static_cast<uint32_t>(mesh.vtx_count);
+}
+
+void Painter::AddMeshSplit(const ShapeCache::Mesh& mesh, const sm::vec2& pos, uint32_t col)
+{
+	const auto uv = PaletteUV();
+	const float* edges = is_analytic_aa(m_flags) ? mesh.edges : nullptr;
+
+	// the new index of each mesh vertex in the current batch
+	m_mesh_remap.resize(mesh.vtx_count);
+	std::fill(m_mesh_remap.begin(), m_mesh_remap.end(), NO_VERTEX);
+	const uint32_t* remap = m_mesh_remap.data();
+
+	split_triangles(mesh.indices, mesh.idx_count, m_mesh_remap.data(), [&](size_t begin, size_t end, uint32_t vtx_count)
+	{
+		m_buf.Reserve(end - begin, vtx_count);
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t src = mesh.indices[i];
+			const uint32_t dst = remap[src];
+			write_vertex(m_buf.vert_ptr[dst], mesh.positions[src] + pos, edges ? sm::vec2(edges[src], 0) : uv, col & mesh.col_masks[src]);
+			m_buf.index_ptr[i - begin] = static_cast<unsigned short>(m_buf.curr_index + dst);
+		}
+		m_buf.vert_ptr  += vtx_count;
+		m_buf.index_ptr += end - begin;
+		m_buf.curr_index += vtx_count;
+	});
+}
+
+void Painter::CacheShape(const ShapeCache::Key& key, const sm::vec2& pos, uint32_t col, size_t vtx_begin, size_t idx_begin)
+{
+	// drawn with one Reserve(), so not split by a flush
+	assert(vtx_begin >= m_buf.flushed_vtx && idx_begin >= m_buf.flushed_idx);
+	vtx_begin -= m_buf.flushed_vtx;
+	idx_begin -= m_buf.flushed_idx;
+
+	const size_t vtx_count = m_buf.vertices.size() - vtx_begin;
+	const size_t idx_count = m_buf.IndexCount() - idx_begin;
+	Vertex* vertices = m_buf.vertices.data() + vtx_begin;
+
+	// small enough to have been drawn with one Reserve(), its indices start at first_index
+	if (vtx_count <= ShapeCache::MAX_VERTICES)
+	{
+		auto mesh = m_shape_cache->Insert(key, vtx_count, idx_count);
+		for (size_t i = 0; i < vtx_count; ++i)
+		{
+			mesh.positions[i] = vertices[i].GetPos();
+			mesh.col_masks[i] = vertices[i].col == col ? 0xFFFFFFFF : ~COL32_A_MASK;
+			mesh.edges[i]     = read_edge(vertices[i]);
+		}
+		const uint32_t first_index = m_buf.curr_index - static_cast<uint32_t>(vtx_count);
+		for (size_t i = 0; i < idx_count; ++i)
+		{
+			const uint32_t idx = m_buf.index_type == IndexType::UInt32
+				? m_buf.indices32[idx_begin + i] : m_buf.indices[idx_begin + i];
+			mesh.indices[i] = idx - first_index;
+		}
+	}
+
+	for (size_t i = 0; i < vtx_count; ++i) {
+		vertices[i].SetPos(vertices[i].GetPos() + pos);
+	}
+}
+
+void Painter::AddInstance(InstanceKind kind, const sm::vec2& center, const sm::vec2& half_size, float rounding, uint32_t col)
+{
+	// a new command for another kind, clip rect, or triangles drawn in between
+	auto& cmds = m_instances.commands;
+	const size_t idx_count = m_buf.TotalIndexCount();
+	if (cmds.empty() || cmds.back().kind != kind || cmds.back().idx_count != idx_count
+	 || !is_same_rect(cmds.back().clip_rect, m_buf.curr_clip_rect))
+	{
+		InstanceCmd cmd;
+		cmd.kind      = kind;
+		cmd.first     = m_instances.instances.size();
+		cmd.idx_count = idx_count;
+		cmd.clip_rect = m_buf.curr_clip_rect;
+		cmds.push_back(cmd);
+	}
+	++cmds.back().count;
+
+	auto& inst = *m_instances.instances.append(1);
+	inst.center    = center;
+	inst.half_size = half_size;
+	inst.rounding  = rounding;
+	inst.col       = col;
+}
+
+Painter::InstanceMesh Painter::BuildInstanceMesh(InstanceKind kind, uint32_t num_segments, bool anti_aliased)
+{
+	// the outline, in the same order as PathArc() and PathRect()
+	std::vector<InstanceVertex> outline;
+	if (kind == InstanceKind::Circle)
+	{
+		const uint32_t num = std::min(std::max(num_segments, 3u), 0x4000u);
+		std::vector<sm::vec2> dirs(num + 1);
+		circle_points(sm::vec2(0, 0), 1.0f, num, 0, num, dirs.data());
+		outline.resize(num);
+		for (uint32_t i = 0; i < num; ++i) {
+			outline[i] = { sm::vec2(0, 0), dirs[i], dirs[i] * 0.5f, 1.0f };
+		}
+	}
+	else
+	{
+		const uint32_t num = std::min(num_segments, 0x1000u);
+		if (num == 0)
+		{
+			// a sharp corner's fringe goes along the miter
+			const sm::vec2 corners[] = { sm::vec2(-1, -1), sm::vec2(1, -1), sm::vec2(1, 1), sm::vec2(-1, 1) };
+			for (auto& c : corners) {
+				outline.push_back({ c, c, c * 0.5f, 1.0f });
+			}
+		}
+		else
+		{
+			const sm::vec2 corners[] = { sm::vec2(1, 1), sm::vec2(-1, 1), sm::vec2(-1, -1), sm::vec2(1, -1) };
+			std::vector<sm::vec2> dirs(num * 4 + 1);
+			circle_points(sm::vec2(0, 0), 1.0f, num * 4, 0, num * 4, dirs.data());
+			for (uint32_t i = 0; i < 4; ++i) {
+				for (uint32_t j = 0; j <= num; ++j) {
+					auto& dir = dirs[num * i + j];
+					outline.push_back({ corners[i], dir, dir * 0.5f, 1.0f });
+				}
+			}
+		}
+	}
+
+	InstanceMesh mesh;
+	const size_t count = outline.size();
+	if (!anti_aliased)
+	{
+		mesh.vertices = outline;
+		for (auto& v : mesh.vertices) {
+			v.fringe = sm::vec2(0, 0);
+		}
+		for (size_t i = 2; i < count; ++i) {
+			mesh.indices.insert(mesh.indices.end(), { 0, static_cast<unsigned short>(i - 1), static_cast<unsigned short>(i) });
+		}
+		return mesh;
+	}
+
+	// inner and outer vertices, indexed as in FillImpl()
+	mesh.vertices.reserve(count * 2);
+	for (auto& v : outline)
+	{
+		InstanceVertex inner = v, outer = v;
+		inner.fringe = -v.fringe;
+		outer.alpha = 0.0f;
+		mesh.vertices.push_back(inner);
+		mesh.vertices.push_back(outer);
+	}
+	for (size_t i = 2; i < count; ++i) {
+		mesh.indices.insert(mesh.indices.end(), { 0, static_cast<unsigned short>((i - 1) << 1), static_cast<unsigned short>(i << 1) });
+	}
+	for (size_t i0 = count - 1, i1 = 0; i1 < count; i0 = i1++)
+	{
+		const auto inner0 = static_cast<unsigned short>(i0 << 1), inner1 = static_cast<unsigned short>(i1 << 1);
+		mesh.indices.insert(mesh.indices.end(), { inner1, inner0, static_cast<unsigned short>(inner0 + 1),
+			static_cast<unsigned short>(inner0 + 1), static_cast<unsigned short>(inner1 + 1), inner1 });
+	}
+	return mesh;
+}
+
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+
+void Painter::AddTexQuad(int tex, const std::array<sm::vec2, 4>& positions, const std::array<sm::vec2, 4>& texcoords, uint32_t color)
+{
+	TESS_STATS_SCOPE(TexQuad);
+	if (!IsVisible(positions.data(), positions.size(), 0)) {
+		return;
+	}
+
+	if (m_buf.index_type == IndexType::UInt32) {
+		AddTexQuadImpl<uint32_t>(tex, positions, texcoords, color);
+	} else {
+		AddTexQuadImpl<unsigned short>(tex, positions, texcoords, color);
+	}
+}
+
+template <typename Index>
+void Painter::AddTexQuadImpl(int tex, const std::array<sm::vec2, 4>& positions, const std::array<sm::vec2, 4>& texcoords, uint32_t color)
+{
+	m_buf.curr_texid = tex;
+	m_buf.Reserve(6, 4);
+	m_buf.curr_texid = PALETTE_TEXID;
+
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+	index_ptr[0] = m_buf.curr_index;
+	index_ptr[1] = m_buf.curr_index + 1;
+	index_ptr[2] = m_buf.curr_index + 2;
+	index_ptr[3] = m_buf.curr_index;
+	index_ptr[4] = m_buf.curr_index + 2;
+	index_ptr[5] = m_buf.curr_index + 3;
+	index_ptr += 6;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		auto& v = m_buf.vert_ptr[i];
+		v.pos = positions[i];
+		v.uv  = texcoords[i];
+		v.col = color;
+	}
+	m_buf.vert_ptr += 4;
+
+	m_buf.curr_index += 4;
+}
+
+#endif // TESS_VERTEX_LAYOUT
+
+void Painter::AddShape(const Shape& shape)
+{
+	switch (shape.type)
+	{
+	case ShapeType::Line:
+		AddLine(shape.p0, shape.p1, shape.col, shape.line_width);
+		break;
+	case ShapeType::DashLine:
+		AddDashLine(shape.p0, shape.p1, shape.col, shape.line_width, shape.step_len);
+		break;
+	case ShapeType::Rect:
+		AddRect(shape.p0, shape.p1, shape.col, shape.line_width, shape.rounding, shape.rounding_corners_flags);
+		break;
+	case ShapeType::RectFilled:
+		AddRectFilled(shape.p0, shape.p1, shape.col, shape.rounding, shape.rounding_corners_flags);
+		break;
+	case ShapeType::Circle:
+		AddCircle(shape.p0, shape.radius, shape.col, shape.line_width, shape.num_segments);
+		break;
+	case ShapeType::CircleFilled:
+		AddCircleFilled(shape.p0, shape.radius, shape.col, shape.num_segments);
+		break;
+	case ShapeType::Arc:
+		AddArc(shape.p0, shape.radius, shape.start_angle, shape.end_angle, shape.col, shape.line_width, shape.num_segments);
+		break;
+	case ShapeType::Triangle:
+		AddTriangle(shape.p0, shape.p1, shape.p2, shape.col, shape.line_width);
+		break;
+	case ShapeType::TriangleFilled:
+		AddTriangleFilled(shape.p0, shape.p1, shape.p2, shape.col);
+		break;
+	case ShapeType::Polyline:
+		AddPolyline(shape.points, shape.count, shape.col, shape.line_width);
+		break;
+	case ShapeType::PolylineMultiColor:
+		AddPolylineMultiColor(shape.points, shape.cols, shape.count, shape.line_width);
+		break;
+	case ShapeType::PolylineDash:
+		AddPolylineDash(shape.points, shape.count, shape.col, shape.line_width, shape.step_len);
+		break;
+	case ShapeType::Polygon:
+		AddPolygon(shape.points, shape.count, shape.col, shape.line_width);
+		break;
+	case ShapeType::PolygonFilled:
+		AddPolygonFilled(shape.points, shape.count, shape.col);
+		break;
+	}
+}
+
+MeshSize Painter::CalcLineSize(float line_width) const
+{
+	return CalcStrokeSize(2, false, line_width);
+}
+
+MeshSize Painter::CalcDashLineSize(const sm::vec2& p0, const sm::vec2& p1, float line_width, float step_len) const
+{
+	const sm::vec2 points[] = { p0, p1 };
+	const float pattern[] = { step_len };
+	return CalcPolylineDashSize(points, 2, pattern, 1, 0, line_width);
+}
+
+MeshSize Painter::CalcRectSize(float line_width, float rounding, uint32_t rounding_corners_flags) const
+{
+	return CalcStrokeSize(PathRectCount(rounding, rounding_corners_flags), false, line_width);
+}
+
+MeshSize Painter::CalcRectFilledSize(float rounding, uint32_t rounding_corners_flags) const
+{
+	if (m_instancing && is_uniform_rounding(rounding, rounding_corners_flags)) {
+		return MeshSize();
+	}
+	return CalcFillSize(PathRectCount(rounding, rounding_corners_flags) - 1);
+}
+
+MeshSize Painter::CalcCircleSize(float radius, float line_width, uint32_t num_segments) const
+{
+	return CalcStrokeSize(PathArcCount(radius - 0.5f, CircleSegments(radius, num_segments)), false, line_width);
+}
+
+MeshSize Painter::CalcCircleFilledSize(float radius, uint32_t num_segments) const
+{
+	if (m_instancing) {
+		return MeshSize();
+	}
+	return CalcFillSize(PathArcCount(radius - 0.5f, CircleSegments(radius, num_segments)) - 1);
+}
+
+MeshSize Painter::CalcArcSize(float radius, float start_angle, float end_angle, float line_width, uint32_t num_segments) const
+{
+	const uint32_t num = ArcSegments(radius, start_angle, end_angle, num_segments);
+	return CalcStrokeSize(PathArcCount(radius - 0.5f, num), false, line_width);
+}
+
+MeshSize Painter::CalcTriangleSize(float line_width) const
+{
+	return CalcStrokeSize(4, false, line_width);
+}
+
+MeshSize Painter::CalcTriangleFilledSize() const
+{
+	return CalcFillSize(3);
+}
+
+MeshSize Painter::CalcPolylineSize(size_t count, float line_width) const
+{
+	return CalcStrokeSize(count, false, line_width);
+}
+
+MeshSize Painter::CalcPolylineDashSize(const sm::vec2* points, size_t count, float line_width, float step_len) const
+{
+	const float pattern[] = { step_len };
+	return CalcPolylineDashSize(points, count, pattern, 1, 0, line_width);
+}
+
+MeshSize Painter::CalcPolylineDashSize(const sm::vec2* points, size_t count, const float* pattern, size_t pattern_count,
+	                                   float phase, float line_width) const
+{
+	MeshSize sz;
+	if (count < 2) {
+		return sz;
+	}
+
+	size_t dash_count = 0;
+	walk_dashes(points, count, pattern, pattern_count, phase,
+		[&](const sm::vec2&) { ++dash_count; },
+		[&](float len)
+		{
+			if (len > 0) {
+				sz += CalcStrokeSize(dash_count, false, line_width);
+			}
+			dash_count = 0;
+		});
+	return sz;
+}
+
+MeshSize Painter::CalcPolygonSize(size_t count, float line_width) const
+{
+	return CalcStrokeSize(count, true, line_width);
+}
+
+MeshSize Painter::CalcPolygonFilledSize(size_t count) const
+{
+	return CalcFillSize(count);
+}
+
+MeshSize Painter::CalcPolygonFilledSize(const sm::vec2* points, size_t count) const
+{
+	if (count >= 3 && convex_orientation(points, count) == 0) {
+		return CalcFillSize(count, m_flags & ~ANALYTIC_AA);
+	}
+	return CalcFillSize(count);
+}
+
+MeshSize Painter::CalcPathSize(const prim::Path& path, float line_width) const
+{
+	MeshSize sz;
+	for (auto& path : path.GetPrevPaths()) {
+		sz += CalcStrokeSize(path.vertices.size(), false, line_width);
+	}
+	sz += CalcStrokeSize(path.GetCurrPath().size(), false, line_width);
+	return sz;
+}
+
+MeshSize Painter::CalcPoint3DSize(float size) const
+{
+	return CalcCircleFilledSize(size);
+}
+
+MeshSize Painter::CalcCubeSize(float line_width) const
+{
+	const auto line = CalcLineSize(line_width);
+	MeshSize sz;
+	sz.vtx_count = line.vtx_count * 12;
+	sz.idx_count = line.idx_count * 12;
+	return sz;
+}
+
+MeshSize Painter::CalcArc3DSize(float line_width, uint32_t num_segments) const
+{
+	return CalcStrokeSize(num_segments, false, line_width);
+}
+
+MeshSize Painter::CalcPolyline3DSize(size_t count, float line_width, bool closed) const
+{
+	return CalcStrokeSize(closed && count > 0 ? count + 1 : count, false, line_width);
+}
+
+#if TESS_VERTEX_LAYOUT == TESS_VERTEX_POS_UV_COL
+MeshSize Painter::CalcTexQuadSize() const
+{
+	MeshSize sz;
+	sz.vtx_count = 4;
+	sz.idx_count = 6;
+	return sz;
+}
+#endif // TESS_VERTEX_LAYOUT
+
+MeshSize Painter::CalcShapeSize(const Shape& shape) const
+{
+	switch (shape.type)
+	{
+	case ShapeType::Line:
+		return CalcLineSize(shape.line_width);
+	case ShapeType::DashLine:
+		return CalcDashLineSize(shape.p0, shape.p1, shape.line_width, shape.step_len);
+	case ShapeType::Rect:
+		return CalcRectSize(shape.line_width, shape.rounding, shape.rounding_corners_flags);
+	case ShapeType::RectFilled:
+		return CalcRectFilledSize(shape.rounding, shape.rounding_corners_flags);
+	case ShapeType::Circle:
+		return CalcCircleSize(shape.radius, shape.line_width, shape.num_segments);
+	case ShapeType::CircleFilled:
+		return CalcCircleFilledSize(shape.radius, shape.num_segments);
+	case ShapeType::Arc:
+		return CalcArcSize(shape.radius, shape.start_angle, shape.end_angle, shape.line_width, shape.num_segments);
+	case ShapeType::Triangle:
+		return CalcTriangleSize(shape.line_width);
+	case ShapeType::TriangleFilled:
+		return CalcTriangleFilledSize();
+	case ShapeType::Polyline:
+	case ShapeType::PolylineMultiColor:
+		return CalcPolylineSize(shape.count, shape.line_width);
+	case ShapeType::PolylineDash:
+		return CalcPolylineDashSize(shape.points, shape.count, shape.line_width, shape.step_len);
+	case ShapeType::Polygon:
+		return CalcPolygonSize(shape.count, shape.line_width);
+	case ShapeType::PolygonFilled:
+		return CalcPolygonFilledSize(shape.points, shape.count);
+	}
+	return MeshSize();
+}
+
+void Painter::AddPainter(const Painter& pt)
+{
+	TESS_STATS_SCOPE(Painter);
+	m_instances.Append(pt.m_instances, m_buf.TotalIndexCount());
+	m_buf.Append(pt.GetBuffer());
+}
+
+void Painter::MergePainters(const Painter* const* painters, size_t count)
+{
+	TESS_STATS_SCOPE(Painter);
+	// one allocation for all of them, the appends only bump the write pointers
+	MeshSize size;
+	size_t cmd_count = 0, inst_count = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& pt = *painters[i];
+		assert(&pt != this);
+		size.vtx_count += pt.m_buf.vertices.size();
+		size.idx_count += pt.m_buf.IndexCount();
+		cmd_count  += pt.m_buf.commands.size();
+		inst_count += pt.m_instances.instances.size();
+	}
+	Preallocate(size);
+	m_buf.commands.reserve(m_buf.commands.size() + cmd_count);
+	m_instances.instances.reserve(m_instances.instances.size() + inst_count);
+
+	for (size_t i = 0; i < count; ++i) {
+		AddPainter(*painters[i]);
+	}
+}
+
+void Painter::Preallocate(const MeshSize& size)
+{
+	m_buf.Preallocate(size.idx_count, size.vtx_count);
+}
+
+void Painter::Resize(size_t vtx_count, size_t idx_count, size_t cmd_count)
+{
+	m_buf.vertices.resize(vtx_count);
+	m_buf.vert_ptr = m_buf.vertices.data() + vtx_count;
+	if (m_buf.index_type == IndexType::UInt32)
+	{
+		m_buf.indices32.resize(idx_count);
+		m_buf.index32_ptr = m_buf.indices32.data() + idx_count;
+	}
+	else
+	{
+		m_buf.indices.resize(idx_count);
+		m_buf.index_ptr = m_buf.indices.data() + idx_count;
+	}
+	m_buf.commands.resize(cmd_count);
+}
+
+void Painter::CalcPainterSize(const Painter& pt, MeshSize& size, size_t& cmd_count) const
+{
+	auto& buf = pt.GetBuffer();
+	size.vtx_count = buf.vertices.size();
+	size.idx_count = buf.IndexCount();
+	cmd_count      = buf.commands.size();
+	if (!NeedsSplit(buf)) {
+		return;
+	}
+
+	size.vtx_count = cmd_count = 0;
+	PodArray<uint32_t> remap;
+	split_commands(buf, remap, [&](const Cmd&, size_t, size_t, uint32_t vtx_count)
+	{
+		size.vtx_count += vtx_count;
+		++cmd_count;
+	});
+}
+
+void Painter::FillPainter(const Painter& pt, size_t vert_off, size_t index_off, size_t cmd_off)
+{
+	TESS_STATS_SCOPE(Painter);
+	auto& buf = pt.GetBuffer();
+	if (buf.IndexCount() == 0 || buf.vertices.empty()) {
+		return;
+	}
+
+	if (NeedsSplit(buf))
+	{
+		FillPainterSplit(pt, vert_off, index_off, cmd_off);
+		return;
+	}
+
+	const size_t cmd_count = buf.commands.size();
+	assert(vert_off + buf.vertices.size() - 1 < m_buf.vertices.size()
+	    && index_off + buf.IndexCount() - 1 < m_buf.IndexCount()
+	    && cmd_off + cmd_count - 1 < m_buf.commands.size());
+
+	std::copy(buf.vertices.begin(), buf.vertices.end(), m_buf.vertices.begin() + vert_off);
+
+	for (size_t i = 0; i < cmd_count; ++i)
+	{
+		auto& src = buf.commands[i];
+		auto& dst = m_buf.commands[cmd_off + i];
+		dst = src;
+		dst.idx_offset += index_off;
+
+		// 16-bit indices stay relative to the moved vertex base, 32-bit ones become absolute
+		uint32_t rebase = 0;
+		if (m_buf.index_type == IndexType::UInt32) {
+			rebase = static_cast<uint32_t>(src.vtx_offset + vert_off);
+			dst.vtx_offset = 0;
+		} else {
+			dst.vtx_offset += vert_off;
+		}
+		for (size_t s = src.idx_offset, e = src.idx_offset + src.elem_count; s < e; ++s)
+		{
+			const uint32_t idx = (buf.index_type == IndexType::UInt32 ? buf.indices32[s] : buf.indices[s]) + rebase;
+			if (m_buf.index_type == IndexType::UInt32) {
+				m_buf.indices32[index_off + s] = idx;
+			} else {
+				assert(idx < Buffer::MAX_VERTICES_16);
+				m_buf.indices[index_off + s] = static_cast<unsigned short>(idx);
+			}
+		}
+	}
+
+	// keep appending after the last range
+	if (cmd_off + cmd_count == m_buf.commands.size()) {
+		m_buf.curr_index = static_cast<uint32_t>(m_buf.vertices.size() - m_buf.commands.back().vtx_offset);
+	}
+}
+
+void Painter::AddInstances(const Painter& pt, size_t index_off)
+{
+	m_instances.Append(pt.m_instances, m_buf.flushed_idx + index_off);
+}
+
+void Painter::LogReservations(PodArray<Reservation>* log)
+{
+	m_buf.reservations = log;
+}
+
+void Painter::PackPainter(const Painter& pt, const PodArray<Reservation>& log, PodArray<Placement>& places)
+{
+	TESS_STATS_SCOPE(Painter);
+	auto& buf = pt.GetBuffer();
+	assert(m_buf.index_type == IndexType::UInt16 && buf.index_type == IndexType::UInt16 && !m_buf.sink);
+	places.clear();
+
+	const int      texid = m_buf.curr_texid;
+	const sm::rect clip  = m_buf.curr_clip_rect;
+	uint32_t delta = 0;
+	for (size_t i = 0, n = log.size(); i < n; ++i)
+	{
+		// a call's data runs up to the next one's
+		auto& r = log[i];
+		const size_t vtx_count = (i + 1 < n ? log[i + 1].vtx_begin : buf.vertices.size()) - r.vtx_begin;
+		const size_t idx_count = (i + 1 < n ? log[i + 1].idx_begin : buf.IndexCount()) - r.idx_begin;
+
+		auto& cmd = buf.commands[r.cmd];
+		m_buf.curr_texid     = cmd.texid;
+		m_buf.curr_clip_rect = cmd.clip_rect;
+		m_buf.Reserve(idx_count, vtx_count);
+
+		// one without vertices indexes those of the calls before it, which moved by the same
+		if (vtx_count > 0) {
+			delta = m_buf.curr_index - static_cast<uint32_t>(r.vtx_begin - cmd.vtx_offset);
+		}
+		const size_t dst_vtx = m_buf.vertices.size() - vtx_count,
+		             dst_idx = m_buf.indices.size() - idx_count;
+		m_buf.curr_index += static_cast<uint32_t>(vtx_count);
+
+		if (!places.empty())
+		{
+			auto& p = places.back();
+			if (p.delta == delta && p.src_vtx + p.vtx_count == r.vtx_begin && p.dst_vtx + p.vtx_count == dst_vtx
+			 && p.src_idx + p.idx_count == r.idx_begin && p.dst_idx + p.idx_count == dst_idx)
+			{
+				p.vtx_count += vtx_count;
+				p.idx_count += idx_count;
+				continue;
+			}
+		}
+
+		Placement p;
+		p.src_vtx   = r.vtx_begin;
+		p.dst_vtx   = dst_vtx;
+		p.vtx_count = vtx_count;
+		p.src_idx   = r.idx_begin;
+		p.dst_idx   = dst_idx;
+		p.idx_count = idx_count;
+		p.delta     = delta;
+		places.push_back(p);
+	}
+
+	m_buf.curr_texid     = texid;
+	m_buf.curr_clip_rect = clip;
+	m_buf.vert_ptr  = m_buf.vertices.data() + m_buf.vertices.size();
+	m_buf.index_ptr = m_buf.indices.data() + m_buf.indices.size();
+}
+
+void Painter::FillPacked(const Painter& pt, const PodArray<Placement>& places)
+{
+	TESS_STATS_SCOPE(Painter);
+	auto& buf = pt.GetBuffer();
+	for (auto& p : places)
+	{
+		std::copy(buf.vertices.begin() + p.src_vtx, buf.vertices.begin() + p.src_vtx + p.vtx_count,
+			m_buf.vertices.begin() + p.dst_vtx);
+		rebase_indices(buf.indices.data() + p.src_idx, p.idx_count, p.delta,
+			m_buf.indices.data() + p.dst_idx);
+	}
+}
+
+bool Painter::NeedsSplit(const Buffer& src) const
+{
+	return m_buf.index_type == IndexType::UInt16 && src.index_type == IndexType::UInt32
+		&& src.vertices.size() > Buffer::MAX_VERTICES_16;
+}
+
+void Painter::FillPainterSplit(const Painter& pt, size_t vert_off, size_t index_off, size_t cmd_off)
+{
+	auto& buf = pt.GetBuffer();
+	PodArray<uint32_t> remap;
+	size_t cmd_idx = cmd_off, vtx_idx = vert_off;
+	split_commands(buf, remap, [&](const Cmd& cmd, size_t begin, size_t end, uint32_t vtx_count)
+	{
+		assert(cmd_idx < m_buf.commands.size() && vtx_idx + vtx_count <= m_buf.vertices.size());
+		auto& dst = m_buf.commands[cmd_idx++];
+		dst = cmd;
+		dst.idx_offset = index_off + begin;
+		dst.elem_count = end - begin;
+		dst.vtx_offset = vtx_idx;
+
+		const uint32_t* r = remap.data() + cmd.vtx_offset;
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t v = buf.indices32[i];
+			m_buf.vertices[vtx_idx + r[v]] = buf.vertices[cmd.vtx_offset + v];
+			m_buf.indices[index_off + i] = static_cast<unsigned short>(r[v]);
+		}
+		vtx_idx += vtx_count;
+	});
+
+	if (cmd_idx == m_buf.commands.size()) {
+		m_buf.curr_index = static_cast<uint32_t>(m_buf.vertices.size() - m_buf.commands.back().vtx_offset);
+	}
+}
+
+void Painter::MergeCommands()
+{
+	m_buf.MergeCommands();
+}
+
+void Painter::Optimize()
+{
+	m_buf.Optimize();
+}
+
+void Painter::PushClipRect(const sm::rect& rect, bool intersect_with_current)
+{
+	sm::rect r = rect;
+	if (intersect_with_current && !m_clip_stack.empty() && m_clip_stack.back().IsValid())
+	{
+		auto& curr = m_clip_stack.back();
+		r.xmin = std::max(r.xmin, curr.xmin);
+		r.ymin = std::max(r.ymin, curr.ymin);
+		r.xmax = std::max(r.xmin, std::min(r.xmax, curr.xmax));
+		r.ymax = std::max(r.ymin, std::min(r.ymax, curr.ymax));
+	}
+	m_clip_stack.push_back(r);
+	m_buf.curr_clip_rect = r;
+}
+
+void Painter::PopClipRect()
+{
+	assert(!m_clip_stack.empty());
+	m_clip_stack.pop_back();
+	m_buf.curr_clip_rect = m_clip_stack.empty() ? sm::rect() : m_clip_stack.back();
+}
+
+bool Painter::IsEmpty() const
+{
+	return m_buf.IndexCount() == 0 && m_instances.instances.empty();
+}
+
+void Painter::Clear()
+{
+	m_buf.Clear();
+	m_buf.flushed_vtx = m_buf.flushed_idx = 0;
+	m_instances.Clear();
+
+	// the state goes with the stack, Buffer::Clear() keeps it for the chunks of a sink
+	m_clip_stack.clear();
+	m_buf.curr_clip_rect = sm::rect();
+	m_buf.curr_texid     = PALETTE_TEXID;
+}
+
+void Painter::SetOutputSink(OutputSink* sink)
+{
+	FlushOutput();
+
+	// back to empty arrays of the painter's own, or to the sink's chunks from the next Reserve()
+	m_buf.Clear();
+	m_buf.vertices.attach(nullptr, 0);
+	m_buf.indices.attach(nullptr, 0);
+	m_buf.indices32.attach(nullptr, 0);
+	m_buf.sink = sink;
+}
+
+void Painter::FlushOutput()
+{
+	if (m_buf.sink) {
+		m_buf.FlushChunk();
+	}
+}
+
+void Painter::EnableShapeCache(bool enable)
+{
+	if (!enable) {
+		m_shape_cache.reset();
+	} else if (!m_shape_cache) {
+		m_shape_cache.reset(new ShapeCache);
+	}
+}
+
+void Painter::SetAntiAliased(bool enable)
+{
+    if (enable) {
+        m_flags |= ANTI_ALIASED_LINES;
+        m_flags |= ANTI_ALIASED_FILL;
+    } else {
+        m_flags &= ~ANTI_ALIASED_LINES;
+        m_flags &= ~ANTI_ALIASED_FILL;
+    }
+}
+
+void Painter::SetAnalyticAntiAliased(bool enable)
+{
+	if (enable) {
+		m_flags |= ANALYTIC_AA;
+	} else {
+		m_flags &= ~ANALYTIC_AA;
+	}
+}
+
+size_t Painter::PathRect(const sm::vec2& p0, const sm::vec2& p1, float rounding, uint32_t rounding_corners_flags)
+{
+	if (rounding > 0.0f && rounding_corners_flags != CORNER_FLAGS_NONE)
+	{
+		// the corners are quarters of one circle
+		const uint32_t num_seg = RectCornerSegments(rounding);
+		const float rounding_tl = (rounding_corners_flags & CORNER_FLAGS_TOP_LEFT)  ? rounding : 0.0f;
+		const float rounding_tr = (rounding_corners_flags & CORNER_FLAGS_TOP_RIGHT) ? rounding : 0.0f;
+		const float rounding_br = (rounding_corners_flags & CORNER_FLAGS_BOT_RIGHT) ? rounding : 0.0f;
+		const float rounding_bl = (rounding_corners_flags & CORNER_FLAGS_BOT_LEFT)  ? rounding : 0.0f;
+		const std::array<std::pair<sm::vec2, float>, 4> corners = {
+			std::make_pair(sm::vec2(p1.x - rounding_tr, p1.y - rounding_tr), rounding_tr),
+			std::make_pair(sm::vec2(p0.x + rounding_tl, p1.y - rounding_tl), rounding_tl),
+			std::make_pair(sm::vec2(p0.x + rounding_bl, p0.y + rounding_bl), rounding_bl),
+			std::make_pair(sm::vec2(p1.x - rounding_br, p0.y + rounding_br), rounding_br),
+		};
+
+		m_points.resize((num_seg + 1) * 4);
+		size_t count = 0;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			auto& centre = corners[i].first;
+			const float r = corners[i].second;
+			if (r == 0.0f) {
+				m_points[count++] = centre;
+			} else {
+				circle_points(centre, r, num_seg * 4, num_seg * i, num_seg, &m_points[count]);
+				count += num_seg + 1;
+			}
+		}
+		return count;
+	}
+	else
+	{
+		m_points.resize(5);
+		m_points[0] = p0;
+		m_points[1] = sm::vec2(p1.x, p0.y);
+		m_points[2] = p1;
+		m_points[3] = sm::vec2(p0.x, p1.y);
+		m_points[4] = p0;
+		return 5;
+	}
+}
+
+size_t Painter::PathArc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t num_segments)
+{
+	// same points as prim::Path::Arc()
+	if (radius == 0.0f)
+	{
+		m_points.resize(1);
+		m_points[0] = centre;
+		return 1;
+	}
+
+	m_points.resize(num_segments + 1);
+	if (start_angle == 0.0f && end_angle == SM_PI * 2.0f) {
+		circle_points(centre, radius, num_segments, 0, num_segments, m_points.data());
+	} else {
+		arc_points(centre, radius, start_angle, end_angle, num_segments, m_points.data());
+	}
+	return num_segments + 1;
+}
+
+size_t Painter::PathRectCount(float rounding, uint32_t rounding_corners_flags) const
+{
+	if (rounding > 0.0f && rounding_corners_flags != CORNER_FLAGS_NONE)
+	{
+		const int num_seg = RectCornerSegments(rounding);
+		size_t count = 0;
+		for (auto flag : { CORNER_FLAGS_TOP_RIGHT, CORNER_FLAGS_TOP_LEFT, CORNER_FLAGS_BOT_LEFT, CORNER_FLAGS_BOT_RIGHT }) {
+			count += PathArcCount((rounding_corners_flags & flag) ? rounding : 0.0f, num_seg);
+		}
+		return count;
+	}
+	else
+	{
+		return 5;
+	}
+}
+
+size_t Painter::PathArcCount(float radius, int num_segments)
 {
-	return m_buf.indices.empty();
+	// same as prim::Path::Arc()
+	return radius == 0.0f ? 1 : std::max(num_segments, 0) + 1;
 }
 
-void Painter::Clear()
+uint32_t Painter::CircleSegments(float radius, uint32_t num_segments) const
 {
-	m_buf.Clear();
-	m_other_texs.clear();
+	if (num_segments != CIRCLE_SEGMENTS_AUTO) {
+		return num_segments;
+	}
+	if (m_circle_max_error <= 0) {
+		return DEFAULT_CIRCLE_SEGMENTS;
+	}
+	return calc_circle_segments(std::abs(radius), m_circle_max_error);
+}
+
+uint32_t Painter::ArcSegments(float radius, float start_angle, float end_angle, uint32_t num_segments) const
+{
+	const float angle = std::abs(start_angle - end_angle);
+	if (num_segments == CIRCLE_SEGMENTS_AUTO && m_circle_max_error > 0) {
+		return static_cast<uint32_t>(std::ceil(angle / (SM_PI * 2.0f) * CircleSegments(radius, num_segments)));
+	}
+	// the fixed counts keep their old meaning, 4 * num_segments for a full turn
+	return static_cast<uint32_t>(std::ceil(angle / SM_PI * 2.0f * CircleSegments(radius, num_segments)));
+}
+
+uint32_t Painter::RectCornerSegments(float rounding) const
+{
+	if (m_circle_max_error <= 0) {
+		return 6;
+	}
+	return std::max(1u, (calc_circle_segments(rounding, m_circle_max_error) + 3) / 4);
+}
+
+MeshSize Painter::CalcStrokeSize(size_t count, bool closed, float line_width) const
+{
+	if (count < 2) {
+		return MeshSize();
+	}
+
+	const size_t max_count = stroke_run_max_count(m_flags, line_width);
+	if (m_buf.index_type == IndexType::UInt16 && count > max_count)
+	{
+		MeshSize sz;
+		for (size_t i = 0; i + 1 < count; i += max_count - 1) {
+			sz += CalcStrokeRunSize(std::min(max_count, count - i), false, line_width);
+		}
+		if (closed) {
+			sz += CalcStrokeRunSize(2, false, line_width);
+		}
+		return sz;
+	}
+
+	return CalcStrokeRunSize(count, closed, line_width);
+}
+
+MeshSize Painter::CalcStrokeRunSize(size_t count, bool closed, float line_width) const
+{
+	const size_t new_count = closed ? count : count - 1;
+
+	MeshSize sz;
+	if ((m_flags & ANTI_ALIASED_LINES) && is_analytic_aa(m_flags))
+	{
+		sz.idx_count = new_count * 6;
+		sz.vtx_count = count * 2;
+	}
+	else if (m_flags & ANTI_ALIASED_LINES)
+	{
+		const bool thick_line = line_width > 1.0f;
+		sz.idx_count = thick_line ? new_count * 18 : new_count * 12;
+		sz.vtx_count = thick_line ? count * 4 : count * 3;
+	}
+	else
+	{
+		sz.idx_count = new_count * 6;
+		sz.vtx_count = new_count * 4;
+	}
+	return sz;
+}
+
+MeshSize Painter::CalcFillSize(size_t count, uint32_t flags) const
+{
+	MeshSize sz;
+	if (count < 3) {
+		return sz;
+	}
+
+	// with 16-bit indices, the fans over max_count points each have two more
+	const size_t max_count = m_buf.index_type == IndexType::UInt16 ? fill_piece_max_count(flags) : 0;
+	if ((flags & ANTI_ALIASED_FILL) && is_analytic_aa(flags))
+	{
+		sz.idx_count = count * 3;
+		sz.vtx_count = count + 1;
+		if (max_count > 0 && count >= max_count) {
+			sz.vtx_count = count + (count + max_count - 3) / (max_count - 2) * 2;
+		}
+	}
+	else
+	{
+		const size_t fan_count = max_count > 0 ? (count + max_count - 5) / (max_count - 2) : 1;
+		const size_t pt_count = count - 2 + fan_count * 2;
+		if (flags & ANTI_ALIASED_FILL)
+		{
+			sz.idx_count = (count - 2) * 3 + count * 6;
+			sz.vtx_count = pt_count * 2;
+		}
+		else
+		{
+			sz.idx_count = (count - 2) * 3;
+			sz.vtx_count = pt_count;
+		}
+	}
+	return sz;
+}
+
+void Painter::Stroke(const sm::vec2* points, size_t ori_count, uint32_t col, bool closed, float line_width)
+{
+	if ((col & COL32_A_MASK) == 0 || ori_count < 2) {
+		return;
+	}
+
+	StrokeImpl(points, UniformColor(col), ori_count, closed, line_width);
+}
+
+void Painter::StrokeMultiColor(const sm::vec2* points, const uint32_t* cols, size_t ori_count, bool closed, float line_width)
+{
+	if (ori_count < 2) {
+		return;
+	}
+
+	StrokeImpl(points, VertexColor(cols), ori_count, closed, line_width);
+}
+
+template <typename Color>
+void Painter::StrokeImpl(const sm::vec2* points, const Color& cols, size_t ori_count, bool closed, float line_width)
+{
+	if (m_buf.index_type == IndexType::UInt32) {
+		StrokeRun<uint32_t>(points, cols, ori_count, closed, line_width);
+		return;
+	}
+
+	// split long polylines into open runs sharing their end points, so each run fits in one draw command.
+	// a closed one ends with a run of its closing segment.
+	const size_t max_count = stroke_run_max_count(m_flags, line_width);
+	if (ori_count > max_count)
+	{
+		for (size_t i = 0; i + 1 < ori_count; i += max_count - 1) {
+			StrokeRun<unsigned short>(points + i, cols.Offset(i), std::min(max_count, ori_count - i), false, line_width);
+		}
+		if (closed)
+		{
+			const sm::vec2 ends[] = { points[ori_count - 1], points[0] };
+			uint32_t end_cols[2];
+			StrokeRun<unsigned short>(ends, cols.Closing(ori_count, end_cols), 2, false, line_width);
+		}
+		return;
+	}
+
+	StrokeRun<unsigned short>(points, cols, ori_count, closed, line_width);
+}
+
+template <typename Index, typename Color>
+void Painter::StrokeRun(const sm::vec2* points, const Color& cols, size_t ori_count, bool closed, float line_width)
+{
+	if ((m_flags & ANTI_ALIASED_LINES) && is_analytic_aa(m_flags))
+	{
+		StrokeAnalytic<Index, Color>(points, cols, ori_count, closed, line_width);
+	}
+	else if (m_flags & ANTI_ALIASED_LINES)
+	{
+		if (line_width > 1.0f) {
+			StrokeAA<Index, Color, true>(points, cols, ori_count, closed, line_width);
+		} else {
+			StrokeAA<Index, Color, false>(points, cols, ori_count, closed, line_width);
+		}
+	}
+	else
+	{
+		StrokeNoAA<Index, Color>(points, cols, ori_count, closed, line_width);
+	}
+}
+
+// code from imgui: https://github.com/ocornut/imgui
+template <typename Index, typename Color, bool THICK>
+void Painter::StrokeAA(const sm::vec2* points, const Color& cols, size_t ori_count, bool closed, float line_width)
+{
+	size_t new_count = closed ? ori_count : ori_count - 1;
+
+	const auto uv = PaletteUV();
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+
+    // Anti-aliased stroke
+    const float AA_SIZE = 1.0f;
+
+    const int idx_count = THICK ? new_count * 18 : new_count * 12;
+    const int vtx_count = THICK ? ori_count * 4 : ori_count * 3;
+	m_buf.Reserve(idx_count, vtx_count);
+
+    // Temporary buffer
+	sm::vec2* temp_normals = Scratch(ori_count * 2);
+	sm::vec2* temp_dm = temp_normals + ori_count;
+
+	calc_segment_normals(points, ori_count, temp_normals);
+	temp_normals[ori_count - 1] = closed
+		? calc_segment_normal(points[ori_count - 1], points[0])
+		: temp_normals[ori_count - 2];
+
+	// Average normals
+	calc_miter_normals(temp_normals, ori_count, temp_dm);
+	temp_dm[0] = closed ? calc_miter_normal(temp_normals[ori_count - 1], temp_normals[0]) : temp_normals[0];
+
+    if (!THICK)
+    {
+        unsigned int idx1 = m_buf.curr_index;
+        for (size_t i1 = 0; i1 < new_count; i1++)
+        {
+            unsigned int idx2 = (i1+1) == ori_count ? m_buf.curr_index : idx1+3;
+
+            // Add indexes
+            index_ptr[0] = (idx2+0); index_ptr[1] = (idx1+0); index_ptr[2] = (idx1+2);
+            index_ptr[3] = (idx1+2); index_ptr[4] = (idx2+2); index_ptr[5] = (idx2+0);
+            index_ptr[6] = (idx2+1); index_ptr[7] = (idx1+1); index_ptr[8] = (idx1+0);
+            index_ptr[9] = (idx1+0); index_ptr[10]= (idx2+0); index_ptr[11]= (idx2+1);
+            index_ptr += 12;
+
+            idx1 = idx2;
+        }
+
+        // Add vertexes
+        for (size_t i = 0; i < ori_count; i++)
+        {
+			const uint32_t col = cols[i];
+			const uint32_t col_trans = col & ~COL32_A_MASK;
+			const sm::vec2 dm = temp_dm[i] * AA_SIZE;
+			write_vertex(m_buf.vert_ptr[0], points[i], uv, col);
+			write_vertex(m_buf.vert_ptr[1], points[i] + dm, uv, col_trans);
+			write_vertex(m_buf.vert_ptr[2], points[i] - dm, uv, col_trans);
+            m_buf.vert_ptr += 3;
+        }
+    }
+    else
+    {
+        const float half_inner_thickness = (line_width - AA_SIZE) * 0.5f;
+
+        unsigned int idx1 = m_buf.curr_index;
+        for (size_t i1 = 0; i1 < new_count; i1++)
+        {
+            unsigned int idx2 = (i1+1) == ori_count ? m_buf.curr_index : idx1+4;
+
+            // Add indexes
+            index_ptr[0]  = (idx2+1); index_ptr[1]  = (idx1+1); index_ptr[2]  = (idx1+2);
+            index_ptr[3]  = (idx1+2); index_ptr[4]  = (idx2+2); index_ptr[5]  = (idx2+1);
+            index_ptr[6]  = (idx2+1); index_ptr[7]  = (idx1+1); index_ptr[8]  = (idx1+0);
+            index_ptr[9]  = (idx1+0); index_ptr[10] = (idx2+0); index_ptr[11] = (idx2+1);
+            index_ptr[12] = (idx2+2); index_ptr[13] = (idx1+2); index_ptr[14] = (idx1+3);
+            index_ptr[15] = (idx1+3); index_ptr[16] = (idx2+3); index_ptr[17] = (idx2+2);
+            index_ptr += 18;
+
+            idx1 = idx2;
+        }
+
+        // Add vertexes
+        for (size_t i = 0; i < ori_count; i++)
+        {
+			const uint32_t col = cols[i];
+			const uint32_t col_trans = col & ~COL32_A_MASK;
+			const sm::vec2 dm_out = temp_dm[i] * (half_inner_thickness + AA_SIZE);
+			const sm::vec2 dm_in  = temp_dm[i] * half_inner_thickness;
+			write_vertex(m_buf.vert_ptr[0], points[i] + dm_out, uv, col_trans);
+			write_vertex(m_buf.vert_ptr[1], points[i] + dm_in,  uv, col);
+			write_vertex(m_buf.vert_ptr[2], points[i] - dm_in,  uv, col);
+			write_vertex(m_buf.vert_ptr[3], points[i] - dm_out, uv, col_trans);
+            m_buf.vert_ptr += 4;
+        }
+    }
+    m_buf.curr_index += vtx_count;
+}
+
+template <typename Index, typename Color>
+void Painter::StrokeNoAA(const sm::vec2* points, const Color& cols, size_t ori_count, bool closed, float line_width)
+{
+	size_t new_count = closed ? ori_count : ori_count - 1;
+
+	const auto uv = PaletteUV();
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+
+	const size_t idx_count = new_count * 6;
+	const size_t vtx_count = new_count * 4;
+	m_buf.Reserve(idx_count, vtx_count);
+
+	for (size_t i = 0; i < new_count; ++i)
+	{
+		const uint32_t col = cols[i];
+
+		const int j = (i + 1) == ori_count ? 0 : i + 1;
+		auto& p0 = points[i];
+		auto& p1 = points[j];
+		auto diff = p1 - p0;
+		auto inv_len = p0 == p1 ? 1 : 1.0f / sm::dis_pos_to_pos(p0, p1);
+		diff *= inv_len;
+
+		const float dx = diff.x * (line_width * 0.5f);
+		const float dy = diff.y * (line_width * 0.5f);
+		write_vertex(m_buf.vert_ptr[0], sm::vec2(p0.x + dy, p0.y - dx), uv, col);
+		write_vertex(m_buf.vert_ptr[1], sm::vec2(p1.x + dy, p1.y - dx), uv, col);
+		write_vertex(m_buf.vert_ptr[2], sm::vec2(p1.x - dy, p1.y + dx), uv, col);
+		write_vertex(m_buf.vert_ptr[3], sm::vec2(p0.x - dy, p0.y + dx), uv, col);
+		m_buf.vert_ptr += 4;
+
+		index_ptr[0] = m_buf.curr_index;
+		index_ptr[1] = m_buf.curr_index + 1;
+		index_ptr[2] = m_buf.curr_index + 2;
+		index_ptr[3] = m_buf.curr_index;
+		index_ptr[4] = m_buf.curr_index + 2;
+		index_ptr[5] = m_buf.curr_index + 3;
+		index_ptr  += 6;
+		m_buf.curr_index += 4;
+	}
+}
+
+// a quad per segment with the edge distance across it, the profile of StrokeAA left to the shader
+template <typename Index, typename Color>
+void Painter::StrokeAnalytic(const sm::vec2* points, const Color& cols, size_t ori_count, bool closed, float line_width)
+{
+	size_t new_count = closed ? ori_count : ori_count - 1;
+
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+
+	// solid up to (line_width - 1) / 2 from the center and fading over one pixel after,
+	// thin lines fade from the center
+	const float AA_SIZE = 1.0f;
+	const float half_width = line_width > 1.0f ? (line_width + AA_SIZE) * 0.5f : AA_SIZE;
+
+	const size_t idx_count = new_count * 6;
+	const size_t vtx_count = ori_count * 2;
+	m_buf.Reserve(idx_count, vtx_count);
+
+	sm::vec2* temp_normals = Scratch(ori_count * 2);
+	sm::vec2* temp_dm = temp_normals + ori_count;
+
+	calc_segment_normals(points, ori_count, temp_normals);
+	temp_normals[ori_count - 1] = closed
+		? calc_segment_normal(points[ori_count - 1], points[0])
+		: temp_normals[ori_count - 2];
+
+	calc_miter_normals(temp_normals, ori_count, temp_dm);
+	temp_dm[0] = closed ? calc_miter_normal(temp_normals[ori_count - 1], temp_normals[0]) : temp_normals[0];
+
+	unsigned int idx1 = m_buf.curr_index;
+	for (size_t i1 = 0; i1 < new_count; i1++)
+	{
+		unsigned int idx2 = (i1 + 1) == ori_count ? m_buf.curr_index : idx1 + 2;
+
+		index_ptr[0] = idx1;     index_ptr[1] = idx1 + 1; index_ptr[2] = idx2 + 1;
+		index_ptr[3] = idx2 + 1; index_ptr[4] = idx2;     index_ptr[5] = idx1;
+		index_ptr += 6;
+
+		idx1 = idx2;
+	}
+
+	for (size_t i = 0; i < ori_count; i++)
+	{
+		const uint32_t col = cols[i];
+		const sm::vec2 dm = temp_dm[i] * half_width;
+		write_vertex(m_buf.vert_ptr[0], points[i] + dm, sm::vec2( 1.0f, 0), col);
+		write_vertex(m_buf.vert_ptr[1], points[i] - dm, sm::vec2(-1.0f, 0), col);
+		m_buf.vert_ptr += 2;
+	}
+	m_buf.curr_index += static_cast<uint32_t>(vtx_count);
+}
+
+void Painter::Fill(const sm::vec2* points, size_t count, uint32_t col, bool reversed, bool keep_fringe)
+{
+	if ((col & COL32_A_MASK) == 0 || count < 3) {
+		return;
+	}
+
+	const bool aa = (m_flags & ANTI_ALIASED_FILL) != 0;
+	if (aa && is_analytic_aa(m_flags) && !keep_fringe)
+	{
+		if (m_buf.index_type == IndexType::UInt32) {
+			FillAnalytic<uint32_t>(points, count, col, reversed);
+		} else {
+			FillAnalytic<unsigned short>(points, count, col, reversed);
+		}
+	}
+	else if (m_buf.index_type == IndexType::UInt32)
+	{
+		if (aa) {
+			FillImpl<uint32_t, true>(points, count, col, reversed);
+		} else {
+			FillImpl<uint32_t, false>(points, count, col, reversed);
+		}
+	}
+	else
+	{
+		if (aa) {
+			FillImpl<unsigned short, true>(points, count, col, reversed);
+		} else {
+			FillImpl<unsigned short, false>(points, count, col, reversed);
+		}
+	}
+}
+
+// code from imgui: https://github.com/ocornut/imgui
+// a fan around the first point, with 16-bit indices cut into fans of the triangles from b to e
+template <typename Index, bool AA>
+void Painter::FillImpl(const sm::vec2* points, size_t count, uint32_t col, bool reversed)
+{
+	const auto uv = PaletteUV();
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+
+	// the triangles (0, i, i + 1) from b to e, the vertices of points 0 and b to e
+	auto fan = [&](const sm::vec2* temp_dm, size_t b, size_t e)
+	{
+		auto local = [b](size_t i) { return static_cast<unsigned int>(i - b + 1); };
+		const size_t pt_count = e - b + 2;
+		if (AA)
+		{
+			// Anti-aliased Fill
+			const float AA_SIZE = reversed ? -1.0f : 1.0f;
+			const uint32_t col_trans = col & ~COL32_A_MASK;
+			const size_t edge_count = (e - b) + (b == 1 ? 1 : 0) + (e == count - 1 ? 1 : 0);
+			const size_t idx_count = (e - b) * 3 + edge_count * 6;
+			const size_t vtx_count = pt_count * 2;
+			m_buf.Reserve(idx_count, vtx_count);
+
+			// Add indexes for fill
+			unsigned int vtx_inner_idx = m_buf.curr_index;
+			unsigned int vtx_outer_idx = m_buf.curr_index+1;
+			for (size_t i = b; i < e; i++)
+			{
+				index_ptr[0] = vtx_inner_idx;
+				index_ptr[1] = vtx_inner_idx + (local(i) << 1);
+				index_ptr[2] = vtx_inner_idx + (local(i + 1) << 1);
+				index_ptr += 3;
+			}
+
+			// Add vertices
+			auto add_vertex = [&](size_t i)
+			{
+				const sm::vec2 dm = temp_dm[i] * (AA_SIZE * 0.5f);
+				write_vertex(m_buf.vert_ptr[0], points[i] - dm, uv, col);        // Inner
+				write_vertex(m_buf.vert_ptr[1], points[i] + dm, uv, col_trans);  // Outer
+				m_buf.vert_ptr += 2;
+			};
+			add_vertex(0);
+			for (size_t i = b; i <= e; i++) {
+				add_vertex(i);
+			}
+
+			// Add indexes for fringes, the outline edges only
+			auto add_fringe = [&](unsigned int i0, unsigned int i1)
+			{
+				index_ptr[0] = vtx_inner_idx + (i1 << 1);
+				index_ptr[1] = vtx_inner_idx + (i0 << 1);
+				index_ptr[2] = vtx_outer_idx + (i0 << 1);
+				index_ptr[3] = vtx_outer_idx + (i0 << 1);
+				index_ptr[4] = vtx_outer_idx + (i1 << 1);
+				index_ptr[5] = vtx_inner_idx + (i1 << 1);
+				index_ptr += 6;
+			};
+			if (e == count - 1) {
+				add_fringe(local(e), 0);
+			}
+			if (b == 1) {
+				add_fringe(0, 1);
+			}
+			for (size_t i = b; i < e; i++) {
+				add_fringe(local(i), local(i + 1));
+			}
+			m_buf.curr_index += static_cast<uint32_t>(vtx_count);
+		}
+		else
+		{
+			const size_t idx_count = (e - b) * 3;
+			const size_t vtx_count = pt_count;
+			m_buf.Reserve(idx_count, vtx_count);
+			write_vertex(m_buf.vert_ptr[0], points[0], uv, col);
+			m_buf.vert_ptr++;
+			for (size_t i = b; i <= e; i++)
+			{
+				write_vertex(m_buf.vert_ptr[0], points[i], uv, col);
+				m_buf.vert_ptr++;
+			}
+			for (size_t i = b; i < e; i++)
+			{
+				index_ptr[0] = m_buf.curr_index;
+				index_ptr[1] = m_buf.curr_index + local(i);
+				index_ptr[2] = m_buf.curr_index + local(i + 1);
+				index_ptr += 3;
+			}
+			m_buf.curr_index += static_cast<uint32_t>(vtx_count);
+		}
+	};
+
+	// Compute normals
+	sm::vec2* temp_dm = nullptr;
+	if (AA)
+	{
+		sm::vec2* temp_normals = Scratch(count * 2);
+		temp_dm = temp_normals + count;
+		calc_segment_normals(points, count, temp_normals);
+		temp_normals[count - 1] = calc_segment_normal(points[count - 1], points[0]);
+
+		// Average normals
+		calc_miter_normals(temp_normals, count, temp_dm);
+		temp_dm[0] = calc_miter_normal(temp_normals[count - 1], temp_normals[0]);
+	}
+
+	if (sizeof(Index) == sizeof(uint32_t))
+	{
+		fan(temp_dm, 1, count - 1);
+		return;
+	}
+	// the pieces of this kernel's fringe, also drawn with ANALYTIC_AA for Fill()'s keep_fringe
+	const size_t step = fill_piece_max_count(AA ? ANTI_ALIASED_FILL : 0) - 2;
+	for (size_t b = 1, e; b < count - 1; b = e)
+	{
+		e = count - 1 - b > step ? b + step : count - 1;
+		fan(temp_dm, b, e);
+	}
+}
+
+// a fan around the center, the edge distance goes from 0 there to 1 on the outline.
+// with 16-bit indices cut into fans of the edges from b to e.
+template <typename Index>
+void Painter::FillAnalytic(const sm::vec2* points, size_t count, uint32_t col, bool reversed)
+{
+	Index*& index_ptr = m_buf.IndexPtr<Index>();
+
+	// the outline moves out half a pixel, where the outer vertices of the fringe in FillImpl are
+	const float AA_SIZE = reversed ? -1.0f : 1.0f;
+
+	sm::vec2* temp_normals = Scratch(count * 2);
+	sm::vec2* temp_dm = temp_normals + count;
+	calc_segment_normals(points, count, temp_normals);
+	temp_normals[count - 1] = calc_segment_normal(points[count - 1], points[0]);
+
+	calc_miter_normals(temp_normals, count, temp_dm);
+	temp_dm[0] = calc_miter_normal(temp_normals[count - 1], temp_normals[0]);
+
+	// inside any convex outline
+	sm::vec2 center(0, 0);
+	for (size_t i = 0; i < count; i++) {
+		center += points[i];
+	}
+	center *= 1.0f / count;
+
+	// the triangles of the edges from point b to e, point count is point 0 again
+	auto fan = [&](size_t b, size_t e)
+	{
+		const bool whole = b == 0 && e == count;
+		const size_t idx_count = (e - b) * 3;
+		const size_t vtx_count = e - b + (whole ? 1 : 2);
+		m_buf.Reserve(idx_count, vtx_count);
+
+		write_vertex(m_buf.vert_ptr[0], center, sm::vec2(0, 0), col);
+		for (size_t i = b; i < b + vtx_count - 1; i++) {
+			const size_t p = i == count ? 0 : i;
+			write_vertex(m_buf.vert_ptr[i - b + 1], points[p] + temp_dm[p] * (AA_SIZE * 0.5f), sm::vec2(1.0f, 0), col);
+		}
+		m_buf.vert_ptr += vtx_count;
+
+		const unsigned int center_idx = m_buf.curr_index;
+		auto add_tri = [&](size_t i0, size_t i1)
+		{
+			index_ptr[0] = center_idx;
+			index_ptr[1] = center_idx + 1 + static_cast<unsigned int>(i0 - b);
+			index_ptr[2] = center_idx + 1 + static_cast<unsigned int>(i1 - b);
+			index_ptr += 3;
+		};
+		if (whole) {
+			add_tri(count - 1, 0);
+		} else if (e == count) {
+			add_tri(count - 1, count);
+		}
+		for (size_t i = b; i < std::min(e, count - 1); i++) {
+			add_tri(i, i + 1);
+		}
+		m_buf.curr_index += static_cast<uint32_t>(vtx_count);
+	};
+
+	const size_t max_count = fill_piece_max_count(m_flags);
+	if (sizeof(Index) == sizeof(uint32_t) || count < max_count)
+	{
+		fan(0, count);
+		return;
+	}
+	const size_t step = max_count - 2;
+	for (size_t b = 0, e; b < count; b = e)
+	{
+		e = count - b > step ? b + step : count;
+		fan(b, e);
+	}
+}
+
+void Painter::FillPolygon(const sm::vec2* points, size_t count, uint32_t col)
+{
+	if ((col & COL32_A_MASK) == 0 || count < 3) {
+		return;
+	}
+
+	const int orientation = convex_orientation(points, count);
+	if (orientation != 0)
+	{
+		Fill(points, count, col, orientation < 0);
+		return;
+	}
+
+	m_triangulator.Begin();
+	m_triangulator.AddContour(points, count);
+	m_triangulator.Triangulate(FillRule::EvenOdd);
+
+	// a simple polygon always splits into count - 2 triangles. the others, with repeated points
+	// or crossing edges, keep the fan of before, so CalcPolygonFilledSize() stays exact. a
+	// pentagram has the right count too, only the sweep sees its edges cross. with ANALYTIC_AA
+	// the fan keeps the fringe of the triangulated mesh, for the same size
+	if (m_triangulator.HasCrossings() || m_triangulator.GetIndices().size() != (count - 2) * 3) {
+		Fill(points, count, col, false, true);
+	} else {
+		FillTriangulated(col);
+	}
+}
+
+void Painter::FillTriangulated(uint32_t col)
+{
+	auto& points   = m_triangulator.GetPoints();
+	auto& contours = m_triangulator.GetContours();
+	auto& tris     = m_triangulator.GetIndices();
+	if (tris.empty()) {
+		return;
+	}
+
+	const size_t count = points.size();
+	if ((m_flags & ANTI_ALIASED_FILL) == 0)
+	{
+		ShapeCache::Mesh mesh;
+		mesh.positions = Scratch(count);
+		std::copy(points.begin(), points.end(), mesh.positions);
+		m_mesh_col_masks.resize(count);
+		std::fill(m_mesh_col_masks.begin(), m_mesh_col_masks.end(), 0xFFFFFFFF);
+		mesh.col_masks = m_mesh_col_masks.data();
+		mesh.indices   = const_cast<uint32_t*>(tris.data());
+		mesh.vtx_count = count;
+		mesh.idx_count = tris.size();
+		AddMesh(mesh, sm::vec2(0, 0), col);
+		return;
+	}
+
+	// inner and outer vertex of each point as in FillImpl(), the fill on the inner ones
+	size_t idx_count = tris.size();
+	for (auto& c : contours) {
+		if (c.outside != 0) {
+			idx_count += c.count * 6;
+		}
+	}
+	sm::vec2* positions = Scratch(count * 4);
+	sm::vec2* temp_normals = positions + count * 2;
+	m_mesh_col_masks.resize(count * 2);
+	m_mesh_indices.resize(idx_count);
+	uint32_t* col_masks = m_mesh_col_masks.data();
+	uint32_t* index_ptr = m_mesh_indices.data();
+
+	for (auto idx : tris) {
+		*index_ptr++ = idx << 1;
+	}
+
+	const float AA_SIZE = 1.0f;
+	for (auto& c : contours)
+	{
+		const sm::vec2* p = points.data() + c.begin;
+		sm::vec2* pos = positions + c.begin * 2;
+		uint32_t* masks = col_masks + c.begin * 2;
+		if (c.outside == 0)
+		{
+			for (size_t i = 0; i < c.count; ++i) {
+				pos[i * 2] = pos[i * 2 + 1] = p[i];
+				masks[i * 2] = masks[i * 2 + 1] = 0xFFFFFFFF;
+			}
+			continue;
+		}
+
+		sm::vec2* normals = temp_normals;
+		sm::vec2* dm = temp_normals + c.count;
+		calc_segment_normals(p, c.count, normals);
+		normals[c.count - 1] = calc_segment_normal(p[c.count - 1], p[0]);
+		calc_miter_normals(normals, c.count, dm);
+		dm[0] = calc_miter_normal(normals[c.count - 1], normals[0]);
+
+		const float half = AA_SIZE * 0.5f * c.outside;
+		for (size_t i = 0; i < c.count; ++i)
+		{
+			const sm::vec2 d = dm[i] * half;
+			pos[i * 2]     = p[i] - d;
+			pos[i * 2 + 1] = p[i] + d;
+			masks[i * 2]     = 0xFFFFFFFF;
+			masks[i * 2 + 1] = ~COL32_A_MASK;
+		}
+
+		const uint32_t inner = static_cast<uint32_t>(c.begin * 2);
+		const uint32_t outer = inner + 1;
+		for (uint32_t i0 = static_cast<uint32_t>(c.count - 1), i1 = 0; i1 < c.count; i0 = i1++)
+		{
+			index_ptr[0] = inner + (i1 << 1);
+			index_ptr[1] = inner + (i0 << 1);
+			index_ptr[2] = outer + (i0 << 1);
+			index_ptr[3] = outer + (i0 << 1);
+			index_ptr[4] = outer + (i1 << 1);
+			index_ptr[5] = inner + (i1 << 1);
+			index_ptr += 6;
+		}
+	}
+
+	ShapeCache::Mesh mesh;
+	mesh.positions = positions;
+	mesh.col_masks = col_masks;
+	mesh.indices   = m_mesh_indices.data();
+	mesh.vtx_count = count * 2;
+	mesh.idx_count = idx_count;
+	AddMesh(mesh, sm::vec2(0, 0), col);
+}
+
+bool Painter::IsVisible(const sm::vec2& min, const sm::vec2& max, float margin) const
+{
+	auto& r = m_buf.curr_clip_rect;
+	if (!r.IsValid()) {
+		return true;
+	}
+	return min.x - margin <= r.xmax && max.x + margin >= r.xmin
+		&& min.y - margin <= r.ymax && max.y + margin >= r.ymin;
 }
 
-void Painter::SetAntiAliased(bool enable)
+bool Painter::IsVisible(const sm::vec2* points, size_t count, float margin) const
 {
-    if (enable) {
-        m_flags |= ANTI_ALIASED_LINES;
-        m_flags |= ANTI_ALIASED_FILL;
-    } else {
-        m_flags &= ~ANTI_ALIASED_LINES;
-        m_flags &= ~ANTI_ALIASED_FILL;
-    }
+	if (!m_buf.curr_clip_rect.IsValid()) {
+		return true;
+	}
+
+	sm::vec2 min, max;
+	calc_bounds(points, count, min, max);
+	return IsVisible(min, max, margin);
 }
 
-prim::Path Painter::PathRect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+template <typename Color>
+void Painter::StrokeVisible(const sm::vec2* points, const Color& cols, size_t count, float line_width)
 {
-	prim::Path path;
-	if (rounding > 0.0f && rounding_corners_flags != CORNER_FLAGS_NONE)
+	auto& r = m_buf.curr_clip_rect;
+	if (!r.IsValid())
 	{
-		const size_t num_seg = 6;
-		const float rounding_tl = (rounding_corners_flags & CORNER_FLAGS_TOP_LEFT)  ? rounding : 0.0f;
-		const float rounding_tr = (rounding_corners_flags & CORNER_FLAGS_TOP_RIGHT) ? rounding : 0.0f;
-		const float rounding_br = (rounding_corners_flags & CORNER_FLAGS_BOT_RIGHT) ? rounding : 0.0f;
-		const float rounding_bl = (rounding_corners_flags & CORNER_FLAGS_BOT_LEFT)  ? rounding : 0.0f;
-		path.Arc(sm::vec2(p1.x - rounding_tr, p1.y - rounding_tr), rounding_tr, 0, SM_PI * 0.5f, num_seg);
-		path.Arc(sm::vec2(p0.x + rounding_tl, p1.y - rounding_tl), rounding_tl, SM_PI * 0.5f, SM_PI, num_seg);
-		path.Arc(sm::vec2(p0.x + rounding_bl, p0.y + rounding_bl), rounding_bl, SM_PI, SM_PI * 1.5f, num_seg);
-		path.Arc(sm::vec2(p1.x - rounding_br, p0.y + rounding_br), rounding_br, SM_PI * 1.5f, SM_PI * 2, num_seg);
+		StrokeSimplified(points, cols, count, false, line_width);
+		return;
 	}
-	else
+
+	const float margin = stroke_margin(line_width);
+	const float xmin = r.xmin - margin, xmax = r.xmax + margin;
+	const float ymin = r.ymin - margin, ymax = r.ymax + margin;
+	auto is_visible = [&](size_t i)
+	{
+		auto& p0 = points[i];
+		auto& p1 = points[i + 1];
+		return std::min(p0.x, p1.x) <= xmax && std::max(p0.x, p1.x) >= xmin
+			&& std::min(p0.y, p1.y) <= ymax && std::max(p0.y, p1.y) >= ymin;
+	};
+
+	// a segment next to a visible one is kept too, so the joins at both ends of a visible run
+	// are the ones of the whole line and only the cut ends, out of the clip rect, differ
+	const size_t NONE = count;
+	size_t begin = NONE;
+	bool prev_visible = false;
+	bool curr_visible = is_visible(0);
+	for (size_t i = 0; i + 1 < count; ++i)
 	{
-		path.MoveTo(p0);
-		path.LineTo({ p1.x, p0.y });
-		path.LineTo(p1);
-		path.LineTo({ p0.x, p1.y });
-		path.LineTo(p0);
+		const bool next_visible = i + 2 < count && is_visible(i + 1);
+		const bool keep = prev_visible || curr_visible || next_visible;
+		if (keep && begin == NONE)
+		{
+			begin = i;
+		}
+		else if (!keep && begin != NONE)
+		{
+			StrokeSimplified(points + begin, cols.Offset(begin), i - begin + 1, false, line_width);
+			begin = NONE;
+		}
+		prev_visible = curr_visible;
+		curr_visible = next_visible;
+	}
+	if (begin != NONE) {
+		StrokeSimplified(points + begin, cols.Offset(begin), count - begin, false, line_width);
 	}
-	return path;
 }
 
-void Painter::Stroke(const sm::vec2* points, size_t ori_count, uint32_t col, bool closed, float line_width)
+template <typename Color>
+void Painter::StrokeSimplified(const sm::vec2* points, const Color& cols, size_t count, bool closed, float line_width)
 {
-	if ((col & COL32_A_MASK) == 0 || ori_count < 2) {
+	if (count < 2) {
+		return;
+	}
+	if (m_polyline_max_error <= 0 || count < 5)
+	{
+		StrokeImpl(points, cols, count, closed, line_width);
 		return;
 	}
 
-	std::vector<uint32_t> colors(ori_count, col);
-	StrokeMultiColor(points, colors.data(), ori_count, closed, line_width);
+	const size_t n = Simplify(points, count);
+	if (n == count)
+	{
+		StrokeImpl(points, cols, count, closed, line_width);
+		return;
+	}
+
+	const uint32_t* index = m_lod_index.data();
+	m_lod_points.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		m_lod_points[i] = points[index[i]];
+	}
+	StrokeImpl(m_lod_points.data(), cols.Gather(index, n, m_lod_cols), n, closed, line_width);
 }
 
-// code from imgui: https://github.com/ocornut/imgui
-void Painter::StrokeMultiColor(const sm::vec2* points, const uint32_t* cols, size_t ori_count, bool closed, float line_width)
+// M4 decimation: a column holds at most 4 points, so the simplified line covers the same
+// span of y in each column and stays within the column's width of the input
+size_t Painter::Simplify(const sm::vec2* points, size_t count)
 {
-	size_t new_count = closed ? ori_count : ori_count - 1;
+	m_lod_index.resize(count);
+	uint32_t* dst = m_lod_index.data();
+	size_t n = 0;
 
-	auto& uv = m_palette ? m_palette->GetWhiteUV() : Palette::GetWhiteUVDefault();
-	if (m_flags & ANTI_ALIASED_LINES)
+	const float inv_width = 1.0f / m_polyline_max_error;
+	auto flush = [&](size_t begin, size_t end, size_t lo, size_t hi)
 	{
-		const bool thick_line = line_width > 1.0f;
-
-        // Anti-aliased stroke
-        const float AA_SIZE = 1.0f;
-
-        const int idx_count = thick_line ? new_count * 18 : new_count * 12;
-        const int vtx_count = thick_line ? ori_count * 4 : ori_count * 3;
-		m_buf.Reserve(idx_count, vtx_count);
-
-        // Temporary buffer
-		sm::vec2* temp_normals = (sm::vec2*)alloca(ori_count * (thick_line ? 5 : 3) * sizeof(sm::vec2));
-		sm::vec2* temp_points = temp_normals + ori_count;
-
-        for (size_t i1 = 0; i1 < new_count; i1++)
-        {
-            const int i2 = (i1+1) == ori_count ? 0 : i1+1;
-			auto& p0 = points[i1];
-			auto& p1 = points[i2];
-			auto diff = p1 - p0;
-			auto inv_len = p0 == p1 ? 1 : 1.0f / sm::dis_pos_to_pos(p0, p1);
-			diff *= inv_len;
-            temp_normals[i1].x = diff.y;
-            temp_normals[i1].y = -diff.x;
-        }
-        if (!closed)
-            temp_normals[ori_count - 1] = temp_normals[ori_count - 2];
+		size_t keep[] = { begin, std::min(lo, hi), std::max(lo, hi), end - 1 };
+		for (auto i : keep)
+		{
+			if (n == 0 || dst[n - 1] != i) {
+				dst[n++] = static_cast<uint32_t>(i);
+			}
+		}
+	};
 
-        if (!thick_line)
-        {
-            if (!closed)
-            {
-                temp_points[0] = points[0] + temp_normals[0] * AA_SIZE;
-                temp_points[1] = points[0] - temp_normals[0] * AA_SIZE;
-                temp_points[(ori_count-1)*2+0] = points[ori_count-1] + temp_normals[ori_count-1] * AA_SIZE;
-                temp_points[(ori_count-1)*2+1] = points[ori_count-1] - temp_normals[ori_count-1] * AA_SIZE;
-            }
-
-            // FIXME-OPT: Merge the different loops, possibly remove the temporary buffer.
-            unsigned int idx1 = m_buf.curr_index;
-            for (size_t i1 = 0; i1 < new_count; i1++)
-            {
-                const int i2 = (i1+1) == ori_count ? 0 : i1+1;
-                unsigned int idx2 = (i1+1) == ori_count ? m_buf.curr_index : idx1+3;
-
-                // Average normals
-                sm::vec2 dm = (temp_normals[i1] + temp_normals[i2]) * 0.5f;
-                float dmr2 = dm.x*dm.x + dm.y*dm.y;
-                if (dmr2 > 0.000001f)
-                {
-                    float scale = 1.0f / dmr2;
-                    if (scale > 100.0f) scale = 100.0f;
-                    dm *= scale;
-                }
-                dm *= AA_SIZE;
-                temp_points[i2*2+0] = points[i2] + dm;
-                temp_points[i2*2+1] = points[i2] - dm;
-
-                // Add indexes
-                m_buf.index_ptr[0] = (idx2+0); m_buf.index_ptr[1] = (idx1+0); m_buf.index_ptr[2] = (idx1+2);
-                m_buf.index_ptr[3] = (idx1+2); m_buf.index_ptr[4] = (idx2+2); m_buf.index_ptr[5] = (idx2+0);
-                m_buf.index_ptr[6] = (idx2+1); m_buf.index_ptr[7] = (idx1+1); m_buf.index_ptr[8] = (idx1+0);
-                m_buf.index_ptr[9] = (idx1+0); m_buf.index_ptr[10]= (idx2+0); m_buf.index_ptr[11]= (idx2+1);
-                m_buf.index_ptr += 12;
-
-                idx1 = idx2;
-            }
-
-            // Add vertexes
-            for (size_t i = 0; i < ori_count; i++)
-            {
-				auto& col = cols[i];
-				const uint32_t col_trans = col & ~COL32_A_MASK;
-                m_buf.vert_ptr[0].pos = points[i];          m_buf.vert_ptr[0].uv = uv; m_buf.vert_ptr[0].col = col;
-                m_buf.vert_ptr[1].pos = temp_points[i*2+0]; m_buf.vert_ptr[1].uv = uv; m_buf.vert_ptr[1].col = col_trans;
-                m_buf.vert_ptr[2].pos = temp_points[i*2+1]; m_buf.vert_ptr[2].uv = uv; m_buf.vert_ptr[2].col = col_trans;
-                m_buf.vert_ptr += 3;
-            }
-        }
-        else
-        {
-            const float half_inner_thickness = (line_width - AA_SIZE) * 0.5f;
-            if (!closed)
-            {
-                temp_points[0] = points[0] + temp_normals[0] * (half_inner_thickness + AA_SIZE);
-                temp_points[1] = points[0] + temp_normals[0] * (half_inner_thickness);
-                temp_points[2] = points[0] - temp_normals[0] * (half_inner_thickness);
-                temp_points[3] = points[0] - temp_normals[0] * (half_inner_thickness + AA_SIZE);
-                temp_points[(ori_count-1)*4+0] = points[ori_count-1] + temp_normals[ori_count-1] * (half_inner_thickness + AA_SIZE);
-                temp_points[(ori_count-1)*4+1] = points[ori_count-1] + temp_normals[ori_count-1] * (half_inner_thickness);
-                temp_points[(ori_count-1)*4+2] = points[ori_count-1] - temp_normals[ori_count-1] * (half_inner_thickness);
-                temp_points[(ori_count-1)*4+3] = points[ori_count-1] - temp_normals[ori_count-1] * (half_inner_thickness + AA_SIZE);
-            }
-
-            // FIXME-OPT: Merge the different loops, possibly remove the temporary buffer.
-            unsigned int idx1 = m_buf.curr_index;
-            for (size_t i1 = 0; i1 < new_count; i1++)
-            {
-                const int i2 = (i1+1) == ori_count ? 0 : i1+1;
-                unsigned int idx2 = (i1+1) == ori_count ? m_buf.curr_index : idx1+4;
-
-                // Average normals
-                sm::vec2 dm = (temp_normals[i1] + temp_normals[i2]) * 0.5f;
-                float dmr2 = dm.x*dm.x + dm.y*dm.y;
-                if (dmr2 > 0.000001f)
-                {
-                    float scale = 1.0f / dmr2;
-                    if (scale > 100.0f) scale = 100.0f;
-                    dm *= scale;
-                }
-                sm::vec2 dm_out = dm * (half_inner_thickness + AA_SIZE);
-                sm::vec2 dm_in = dm * half_inner_thickness;
-                temp_points[i2*4+0] = points[i2] + dm_out;
-                temp_points[i2*4+1] = points[i2] + dm_in;
-                temp_points[i2*4+2] = points[i2] - dm_in;
-                temp_points[i2*4+3] = points[i2] - dm_out;
-
-                // Add indexes
-                m_buf.index_ptr[0]  = (idx2+1); m_buf.index_ptr[1]  = (idx1+1); m_buf.index_ptr[2]  = (idx1+2);
-                m_buf.index_ptr[3]  = (idx1+2); m_buf.index_ptr[4]  = (idx2+2); m_buf.index_ptr[5]  = (idx2+1);
-                m_buf.index_ptr[6]  = (idx2+1); m_buf.index_ptr[7]  = (idx1+1); m_buf.index_ptr[8]  = (idx1+0);
-                m_buf.index_ptr[9]  = (idx1+0); m_buf.index_ptr[10] = (idx2+0); m_buf.index_ptr[11] = (idx2+1);
-                m_buf.index_ptr[12] = (idx2+2); m_buf.index_ptr[13] = (idx1+2); m_buf.index_ptr[14] = (idx1+3);
-                m_buf.index_ptr[15] = (idx1+3); m_buf.index_ptr[16] = (idx2+3); m_buf.index_ptr[17] = (idx2+2);
-                m_buf.index_ptr += 18;
-
-                idx1 = idx2;
-            }
-
-            // Add vertexes
-            for (size_t i = 0; i < ori_count; i++)
-            {
-				auto& col = cols[i];
-				const uint32_t col_trans = col & ~COL32_A_MASK;
-                m_buf.vert_ptr[0].pos = temp_points[i*4+0]; m_buf.vert_ptr[0].uv = uv; m_buf.vert_ptr[0].col = col_trans;
-                m_buf.vert_ptr[1].pos = temp_points[i*4+1]; m_buf.vert_ptr[1].uv = uv; m_buf.vert_ptr[1].col = col;
-                m_buf.vert_ptr[2].pos = temp_points[i*4+2]; m_buf.vert_ptr[2].uv = uv; m_buf.vert_ptr[2].col = col;
-                m_buf.vert_ptr[3].pos = temp_points[i*4+3]; m_buf.vert_ptr[3].uv = uv; m_buf.vert_ptr[3].col = col_trans;
-                m_buf.vert_ptr += 4;
-            }
-        }
-        m_buf.curr_index += vtx_count;
-	}
-	else
+	size_t begin = 0, lo = 0, hi = 0;
+	float column = std::floor(points[0].x * inv_width);
+	for (size_t i = 1; i < count; ++i)
 	{
-		const size_t idx_count = new_count * 6;
-		const size_t vtx_count = new_count * 4;
-		m_buf.Reserve(idx_count, vtx_count);
-
-		for (size_t i = 0; i < new_count; ++i)
+		const float c = std::floor(points[i].x * inv_width);
+		if (c != column)
 		{
-			auto& col = cols[i];
-
-			const int j = (i + 1) == ori_count ? 0 : i + 1;
-			auto& p0 = points[i];
-			auto& p1 = points[j];
-			auto diff = p1 - p0;
-			auto inv_len = p0 == p1 ? 1 : 1.0f / sm::dis_pos_to_pos(p0, p1);
-			diff *= inv_len;
+			flush(begin, i, lo, hi);
+			begin = lo = hi = i;
+			column = c;
+			continue;
+		}
+		if (points[i].y < points[lo].y) {
+			lo = i;
+		}
+		if (points[i].y > points[hi].y) {
+			hi = i;
+		}
+	}
+	flush(begin, count, lo, hi);
 
-			const float dx = diff.x * (line_width * 0.5f);
-			const float dy = diff.y * (line_width * 0.5f);
-			m_buf.vert_ptr[0].pos.x = p0.x + dy; m_buf.vert_ptr[0].pos.y = p0.y - dx; m_buf.vert_ptr[0].uv = uv; m_buf.vert_ptr[0].col = col;
-			m_buf.vert_ptr[1].pos.x = p1.x + dy; m_buf.vert_ptr[1].pos.y = p1.y - dx; m_buf.vert_ptr[1].uv = uv; m_buf.vert_ptr[1].col = col;
-			m_buf.vert_ptr[2].pos.x = p1.x - dy; m_buf.vert_ptr[2].pos.y = p1.y + dx; m_buf.vert_ptr[2].uv = uv; m_buf.vert_ptr[2].col = col;
-			m_buf.vert_ptr[3].pos.x = p0.x - dy; m_buf.vert_ptr[3].pos.y = p0.y + dx; m_buf.vert_ptr[3].uv = uv; m_buf.vert_ptr[3].col = col;
-			m_buf.vert_ptr += 4;
+	return n;
+}
 
-			m_buf.index_ptr[0] = m_buf.curr_index;
-			m_buf.index_ptr[1] = m_buf.curr_index + 1;
-			m_buf.index_ptr[2] = m_buf.curr_index + 2;
-			m_buf.index_ptr[3] = m_buf.curr_index;
-			m_buf.index_ptr[4] = m_buf.curr_index + 2;
-			m_buf.index_ptr[5] = m_buf.curr_index + 3;
-			m_buf.index_ptr  += 6;
-			m_buf.curr_index += 4;
-		}
+sm::vec2 Painter::PaletteUV() const
+{
+	// the analytic shader reads an edge distance from uv, 0 is fully inside
+	if (is_analytic_aa(m_flags)) {
+		return sm::vec2(0, 0);
 	}
+	return m_palette ? m_palette->GetWhiteUV() : Palette::GetWhiteUVDefault();
 }
 
-// code from imgui: https://github.com/ocornut/imgui
-void Painter::Fill(const sm::vec2* points, size_t count, uint32_t col)
+sm::vec2* Painter::Scratch(size_t count)
 {
-	if ((col & COL32_A_MASK) == 0 || count < 3) {
-		return;
+	if (m_scratch.size() < count) {
+		m_scratch.resize(count);
 	}
+	return m_scratch.data();
+}
 
-	auto& uv = m_palette ? m_palette->GetWhiteUV() : Palette::GetWhiteUVDefault();
-	if (m_flags & ANTI_ALIASED_FILL)
-    {
-        // Anti-aliased Fill
-        const float AA_SIZE = 1.0f;
-        const uint32_t col_trans = col & ~COL32_A_MASK;
-        const int idx_count = (count - 2) * 3 + count * 6;
-        const int vtx_count = (count * 2);
-		m_buf.Reserve(idx_count, vtx_count);
+void Painter::StrokeClipped(size_t count, const Viewport& vp, uint32_t col, bool closed, float line_width)
+{
+	const sm::vec4* cp = m_clip_pos.data();
 
-        // Add indexes for fill
-        unsigned int vtx_inner_idx = m_buf.curr_index;
-        unsigned int vtx_outer_idx = m_buf.curr_index+1;
-        for (int i = 2; i < static_cast<int>(count); i++)
-        {
-            m_buf.index_ptr[0] = vtx_inner_idx;
-			m_buf.index_ptr[1] = vtx_inner_idx + ((i - 1) << 1);
-			m_buf.index_ptr[2] = vtx_inner_idx + (i << 1);
-            m_buf.index_ptr += 3;
-        }
+	size_t first_out = 0;
+	while (first_out < count && in_front(cp[first_out])) {
+		++first_out;
+	}
 
-        // Compute normals
-        sm::vec2* temp_normals = (sm::vec2*)alloca(count * sizeof(sm::vec2));
-        for (int i0 = count-1, i1 = 0; i1 < static_cast<int>(count); i0 = i1++)
-        {
-            const sm::vec2& p0 = points[i0];
-            const sm::vec2& p1 = points[i1];
-            sm::vec2 diff = p1 - p0;
-			auto inv_len = p0 == p1 ? 1 : 1.0f / sm::dis_pos_to_pos(p0, p1);
-			diff *= inv_len;
-            temp_normals[i0].x = diff.y;
-            temp_normals[i0].y = -diff.x;
-        }
+	// a run gains at most the two points where it crosses the near plane
+	m_points.resize(count + 2);
+	sm::vec2* sp = m_points.data();
+	if (first_out == count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			sp[i] = to_screen(cp[i], vp);
+		}
+		StrokeSimplified(sp, UniformColor(col), count, closed, line_width);
+		return;
+	}
 
-        for (int i0 = count-1, i1 = 0; i1 < static_cast<int>(count); i0 = i1++)
-        {
-            // Average normals
-            const sm::vec2& n0 = temp_normals[i0];
-            const sm::vec2& n1 = temp_normals[i1];
-            sm::vec2 dm = (n0 + n1) * 0.5f;
-			float dmr2 = dm.LengthSquared();
-            if (dmr2 > 0.000001f)
-            {
-                float scale = 1.0f / dmr2;
-                if (scale > 100.0f) scale = 100.0f;
-                dm *= scale;
-            }
-            dm *= AA_SIZE * 0.5f;
-
-            // Add vertices
-            m_buf.vert_ptr[0].pos = (points[i1] - dm); m_buf.vert_ptr[0].uv = uv; m_buf.vert_ptr[0].col = col;        // Inner
-            m_buf.vert_ptr[1].pos = (points[i1] + dm); m_buf.vert_ptr[1].uv = uv; m_buf.vert_ptr[1].col = col_trans;  // Outer
-            m_buf.vert_ptr += 2;
-
-            // Add indexes for fringes
-            m_buf.index_ptr[0] = vtx_inner_idx + (i1 << 1);
-			m_buf.index_ptr[1] = vtx_inner_idx + (i0 << 1);
-			m_buf.index_ptr[2] = vtx_outer_idx + (i0 << 1);
-            m_buf.index_ptr[3] = vtx_outer_idx + (i0 << 1);
-			m_buf.index_ptr[4] = vtx_outer_idx + (i1 << 1);
-			m_buf.index_ptr[5] = vtx_inner_idx + (i1 << 1);
-            m_buf.index_ptr += 6;
-        }
-        m_buf.curr_index += vtx_count;
-    }
-	else
+	// closed loops start walking at a hidden point, so no visible run wraps around
+	const size_t start = closed ? first_out : 0;
+	const size_t edge_num = closed ? count : count - 1;
+
+	size_t n = 0;
+	if (in_front(cp[start])) {
+		sp[n++] = to_screen(cp[start], vp);
+	}
+	for (size_t i = 0; i < edge_num; ++i)
 	{
-		const size_t idx_count = (count - 2) * 3;
-		const size_t vtx_count = count;
-		m_buf.Reserve(idx_count, vtx_count);
-		for (size_t i = 0; i < vtx_count; i++)
+		auto& a = cp[(start + i) % count];
+		auto& b = cp[(start + i + 1) % count];
+		const bool a_in = in_front(a), b_in = in_front(b);
+		if (a_in && b_in)
 		{
-			m_buf.vert_ptr[0].pos = points[i];
-			m_buf.vert_ptr[0].uv = uv;
-			m_buf.vert_ptr[0].col = col;
-			m_buf.vert_ptr++;
+			sp[n++] = to_screen(b, vp);
 		}
-		for (unsigned short i = 2; i < count; i++)
+		else if (a_in)
 		{
-			m_buf.index_ptr[0] = m_buf.curr_index;
-			m_buf.index_ptr[1] = m_buf.curr_index + i - 1;
-			m_buf.index_ptr[2] = m_buf.curr_index + i;
-			m_buf.index_ptr += 3;
+			sp[n++] = to_screen(clip_near(a, b), vp);
+			StrokeSimplified(sp, UniformColor(col), n, false, line_width);
+			n = 0;
+		}
+		else if (b_in)
+		{
+			sp[n++] = to_screen(clip_near(a, b), vp);
+			sp[n++] = to_screen(b, vp);
+		}
+	}
+	StrokeSimplified(sp, UniformColor(col), n, false, line_width);
+}
+
+// Sutherland-Hodgman against the near plane only, a polygon gains at most one point per crossing
+void Painter::FillClipped(size_t count, const Viewport& vp, uint32_t col)
+{
+	const sm::vec4* cp = m_clip_pos.data();
+
+	m_points.resize(count * 2);
+	sm::vec2* sp = m_points.data();
+	size_t n = 0;
+	for (size_t i = 0, prev = count - 1; i < count; prev = i++)
+	{
+		const bool prev_in = in_front(cp[prev]), curr_in = in_front(cp[i]);
+		if (prev_in != curr_in) {
+			sp[n++] = to_screen(clip_near(cp[prev], cp[i]), vp);
+		}
+		if (curr_in) {
+			sp[n++] = to_screen(cp[i], vp);
 		}
-		m_buf.curr_index += static_cast<unsigned short>(vtx_count);
 	}
+
+	FillPolygon(sp, n, col);
 }
 
 void Painter::Stroke(const prim::Path& path, uint32_t col, float line_width)
@@ -804,61 +3405,570 @@ void Painter::Stroke(const prim::Path& path, uint32_t col, float line_width)
 	Stroke(p.data(), p.size(), col, false, line_width);
 }
 
-void Painter::Fill(const prim::Path& path, uint32_t col)
+void Painter::Fill(const prim::Path& path, uint32_t col, FillRule rule)
 {
+	m_triangulator.Begin();
 	for (auto& path : path.GetPrevPaths()) {
-		Fill(path.vertices.data(), path.vertices.size(), col);
+		m_triangulator.AddContour(path.vertices.data(), path.vertices.size());
 	}
 	auto& p = path.GetCurrPath();
-	Fill(p.data(), p.size() - 1, col);
+	m_triangulator.AddContour(p.data(), p.size());
+	m_triangulator.Triangulate(rule);
+	FillTriangulated(col);
 }
 
 //////////////////////////////////////////////////////////////////////////
 // struct Painter::Buffer
 //////////////////////////////////////////////////////////////////////////
 
+Painter::Buffer::Buffer(IndexType index_type)
+	: index_type(index_type)
+{
+}
+
 Painter::Buffer::Buffer(const Buffer& buf)
-	: vertices(buf.vertices)
+	: index_type(buf.index_type)
+	, commands(buf.commands)
+	, vertices(buf.vertices)
 	, indices(buf.indices)
+	, indices32(buf.indices32)
+	, curr_texid(buf.curr_texid)
+	, curr_clip_rect(buf.curr_clip_rect)
 	, curr_index(buf.curr_index)
 {
-	vert_ptr  = vertices.data() + vertices.size();
-	index_ptr = indices.data() + indices.size();
+	vert_ptr    = vertices.data() + vertices.size();
+	index_ptr   = indices.data() + indices.size();
+	index32_ptr = indices32.data() + indices32.size();
 }
 
 Painter::Buffer& Painter::Buffer::operator = (const Buffer& buf)
 {
-	vertices   = buf.vertices;
-	indices    = buf.indices;
-	curr_index = buf.curr_index;
-	vert_ptr   = vertices.data() + vertices.size();
-	index_ptr  = indices.data() + indices.size();
+	index_type     = buf.index_type;
+	commands       = buf.commands;
+	curr_texid     = buf.curr_texid;
+	curr_clip_rect = buf.curr_clip_rect;
+	vertices    = buf.vertices;
+	indices     = buf.indices;
+	indices32   = buf.indices32;
+	curr_index  = buf.curr_index;
+	vert_ptr    = vertices.data() + vertices.size();
+	index_ptr   = indices.data() + indices.size();
+	index32_ptr = indices32.data() + indices32.size();
+	return *this;
+}
+
+Painter::Buffer::Buffer(Buffer&& buf) noexcept
+{
+	swap(buf);
+}
+
+Painter::Buffer& Painter::Buffer::operator = (Buffer&& buf) noexcept
+{
+	swap(buf);
 	return *this;
 }
 
+// the write pointers go along with the arrays they point into
+void Painter::Buffer::swap(Buffer& buf) noexcept
+{
+	using std::swap;
+	swap(index_type, buf.index_type);
+	swap(commands, buf.commands);
+	vertices.swap(buf.vertices);
+	indices.swap(buf.indices);
+	indices32.swap(buf.indices32);
+	swap(curr_texid, buf.curr_texid);
+	swap(curr_clip_rect, buf.curr_clip_rect);
+	swap(curr_index, buf.curr_index);
+	swap(vert_ptr, buf.vert_ptr);
+	swap(index_ptr, buf.index_ptr);
+	swap(index32_ptr, buf.index32_ptr);
+	swap(sink, buf.sink);
+	swap(flushed_vtx, buf.flushed_vtx);
+	swap(flushed_idx, buf.flushed_idx);
+	swap(reservations, buf.reservations);
+#if TESS_ENABLE_STATS
+	swap(reallocs, buf.reallocs);
+	swap(bytes_moved, buf.bytes_moved);
+#endif // TESS_ENABLE_STATS
+}
+
 void Painter::Buffer::Reserve(size_t idx_count, size_t vtx_count)
 {
-	//assert(!commands.empty());
-	//commands.back().elem_count += idx_count;
+	assert(index_type == IndexType::UInt32 || vtx_count <= MAX_VERTICES_16);
+	if (sink) {
+		Fit(idx_count, vtx_count);
+	}
+
+	Cmd cmd;
+	cmd.texid     = curr_texid;
+	cmd.clip_rect = curr_clip_rect;
+	const bool overflow = index_type == IndexType::UInt16 && curr_index + vtx_count > MAX_VERTICES_16;
+	if (commands.empty() || overflow)
+	{
+		cmd.idx_offset = IndexCount();
+		cmd.vtx_offset = index_type == IndexType::UInt32 ? 0 : vertices.size();
+		commands.push_back(cmd);
+		curr_index = static_cast<uint32_t>(vertices.size() - cmd.vtx_offset);
+	}
+	else if (!is_same_state(commands.back(), cmd))
+	{
+		// state change only, keep the vertex base
+		cmd.idx_offset = IndexCount();
+		cmd.vtx_offset = commands.back().vtx_offset;
+		commands.push_back(cmd);
+	}
+	commands.back().elem_count += idx_count;
+
+#if TESS_ENABLE_STATS
+	const size_t vtx_capacity = vertices.capacity(), idx_capacity = IndexCapacity();
+#endif // TESS_ENABLE_STATS
+
+	// capacity survives Clear(), so this is only a pointer bump once warmed up
+	vert_ptr = vertices.append(vtx_count);
+	if (index_type == IndexType::UInt32) {
+		index32_ptr = indices32.append(idx_count);
+	} else {
+		index_ptr = indices.append(idx_count);
+	}
+
+#if TESS_ENABLE_STATS
+	if (vertices.capacity() != vtx_capacity)
+	{
+		++reallocs;
+		bytes_moved += (vertices.size() - vtx_count) * sizeof(Vertex);
+	}
+	if (IndexCapacity() != idx_capacity)
+	{
+		++reallocs;
+		const size_t idx_size = index_type == IndexType::UInt32 ? sizeof(uint32_t) : sizeof(unsigned short);
+		bytes_moved += (IndexCount() - idx_count) * idx_size;
+	}
+#endif // TESS_ENABLE_STATS
+
+	if (reservations)
+	{
+		Reservation r;
+		r.vtx_begin = vertices.size() - vtx_count;
+		r.idx_begin = IndexCount() - idx_count;
+		r.cmd       = commands.size() - 1;
+		reservations->push_back(r);
+	}
+}
+
+void Painter::Buffer::Preallocate(size_t idx_count, size_t vtx_count)
+{
+	// the chunks have a fixed size
+	if (sink) {
+		return;
+	}
+
+	auto grow = [](auto& arr, size_t count)
+	{
+		const size_t size = arr.size() + count;
+		if (size > arr.capacity()) {
+			arr.reserve(std::max(size, arr.capacity() * 2));
+		}
+	};
+	grow(vertices, vtx_count);
+	if (index_type == IndexType::UInt32) {
+		grow(indices32, idx_count);
+	} else {
+		grow(indices, idx_count);
+	}
+}
+
+void Painter::Buffer::Append(const Buffer& src)
+{
+	const int      texid     = curr_texid;
+	const sm::rect clip_rect = curr_clip_rect;
+
+	// a 32-bit block too big for one command, cut into runs of triangles with vertices of their own.
+	// the chunks of a sink hold less than that, the block is cut to fit them below
+	if (!sink && index_type == IndexType::UInt16 && src.index_type == IndexType::UInt32 && src.vertices.size() > MAX_VERTICES_16)
+	{
+		PodArray<uint32_t> remap;
+		split_commands(src, remap, [&](const Cmd& cmd, size_t begin, size_t end, uint32_t vtx_count)
+		{
+			curr_texid     = cmd.texid;
+			curr_clip_rect = cmd.clip_rect;
+			Reserve(end - begin, vtx_count);
+			const uint32_t* r = remap.data() + cmd.vtx_offset;
+			for (size_t i = begin; i < end; ++i)
+			{
+				const uint32_t v = src.indices32[i];
+				vert_ptr[r[v]] = src.vertices[cmd.vtx_offset + v];
+				index_ptr[i - begin] = static_cast<unsigned short>(curr_index + r[v]);
+			}
+			vert_ptr   += vtx_count;
+			index_ptr  += end - begin;
+			curr_index += vtx_count;
+		});
+		curr_texid     = texid;
+		curr_clip_rect = clip_rect;
+		return;
+	}
+
+	// commands sharing a vertex base are moved as one block
+	PodArray<uint32_t> remap;
+	for (size_t i = 0, n = src.commands.size(); i < n; )
+	{
+		const size_t vtx_begin = src.commands[i].vtx_offset;
+		size_t j = i + 1;
+		while (j < n && src.commands[j].vtx_offset == vtx_begin) {
+			++j;
+		}
+		const size_t vtx_end = j < n ? src.commands[j].vtx_offset : src.vertices.size();
+
+		const size_t vtx_count = vtx_end - vtx_begin;
+		if (sink)
+		{
+			// the Reserve() calls below share the vertices, keep them in one chunk
+			size_t idx_count = 0;
+			for (size_t k = i; k < j; ++k) {
+				idx_count += src.commands[k].elem_count;
+			}
+			Fit(idx_count, vtx_count);
+			if (vertices.size() + vtx_count > vertices.capacity() || IndexCount() + idx_count > IndexCapacity())
+			{
+				append_cut(*this, src, i, j, remap);
+				i = j;
+				continue;
+			}
+		}
+
+		uint32_t base = 0;
+		for (size_t k = i; k < j; ++k)
+		{
+			auto& cmd = src.commands[k];
+			curr_texid     = cmd.texid;
+			curr_clip_rect = cmd.clip_rect;
+			if (k == i)
+			{
+				Reserve(cmd.elem_count, vtx_count);
+				std::copy(src.vertices.begin() + vtx_begin, src.vertices.begin() + vtx_end, vert_ptr);
+				vert_ptr += vtx_count;
+				base = curr_index;
+			}
+			else
+			{
+				Reserve(cmd.elem_count, 0);
+			}
+
+			const uint32_t off = base + static_cast<uint32_t>(cmd.vtx_offset - vtx_begin);
+			append_indices(*this, src, cmd.idx_offset, cmd.elem_count, off);
+		}
+		curr_index += static_cast<uint32_t>(vtx_count);
+
+		i = j;
+	}
+	curr_texid     = texid;
+	curr_clip_rect = clip_rect;
+}
+
+void Painter::Buffer::MergeCommands()
+{
+	if (commands.empty()) {
+		return;
+	}
+
+	size_t dst = 0;
+	for (size_t src = 1, n = commands.size(); src < n; ++src)
+	{
+		auto& prev = commands[dst];
+		auto& curr = commands[src];
+		bool merged = false;
+		if (is_same_state(prev, curr) && prev.idx_offset + prev.elem_count == curr.idx_offset)
+		{
+			if (curr.vtx_offset == prev.vtx_offset)
+			{
+				merged = true;
+			}
+			else
+			{
+				// 16-bit only, rebase if the vertices of curr are still reachable from prev's base
+				size_t vtx_end = vertices.size();
+				for (size_t i = src + 1; i < n; ++i) {
+					if (commands[i].vtx_offset != curr.vtx_offset) {
+						vtx_end = std::max(commands[i].vtx_offset, curr.vtx_offset);
+						break;
+					}
+				}
+				if (curr.vtx_offset > prev.vtx_offset && vtx_end - prev.vtx_offset <= MAX_VERTICES_16)
+				{
+					const auto rebase = static_cast<unsigned short>(curr.vtx_offset - prev.vtx_offset);
+					for (size_t i = curr.idx_offset, e = curr.idx_offset + curr.elem_count; i < e; ++i) {
+						indices[i] += rebase;
+					}
+					merged = true;
+				}
+			}
+		}
+
+		if (merged) {
+			prev.elem_count += curr.elem_count;
+		} else {
+			commands[++dst] = curr;
+		}
+	}
+	commands.resize(dst + 1);
+	curr_index = static_cast<uint32_t>(vertices.size() - commands.back().vtx_offset);
+}
+
+void Painter::Buffer::Optimize()
+{
+	const uint32_t NONE = 0xffffffff;
+
+	VertexCacheOptimizer optimizer;
+	PodArray<Vertex>   dst_vertices;
+	PodArray<uint32_t> order, weld, remap, cmd_indices;
+	dst_vertices.reserve(vertices.size());
+
+	// commands sharing a vertex base index the same block, as in Append()
+	for (size_t i = 0, n = commands.size(); i < n; )
+	{
+		const size_t vtx_begin = commands[i].vtx_offset;
+		size_t j = i + 1;
+		while (j < n && commands[j].vtx_offset == vtx_begin) {
+			++j;
+		}
+		const size_t vtx_end = j < n ? commands[j].vtx_offset : vertices.size();
+		const size_t vtx_count = vtx_end - vtx_begin;
+		const Vertex* src = vertices.data() + vtx_begin;
+
+		// each vertex to the first one with the same bytes
+		order.resize(vtx_count);
+		for (size_t v = 0; v < vtx_count; ++v) {
+			order[v] = static_cast<uint32_t>(v);
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			const int cmp = std::memcmp(&src[a], &src[b], sizeof(Vertex));
+			return cmp != 0 ? cmp < 0 : a < b;
+		});
+		weld.resize(vtx_count);
+		for (size_t k = 0; k < vtx_count; ++k)
+		{
+			const bool same = k > 0 && std::memcmp(&src[order[k]], &src[order[k - 1]], sizeof(Vertex)) == 0;
+			weld[order[k]] = same ? weld[order[k - 1]] : order[k];
+		}
+
+		// the vertices are written in the order the optimized triangles first use them
+		const size_t dst_begin = dst_vertices.size();
+		remap.resize(vtx_count);
+		std::fill(remap.begin(), remap.end(), NONE);
+		for (size_t k = i; k < j; ++k)
+		{
+			auto& cmd = commands[k];
+			cmd_indices.resize(cmd.elem_count);
+			for (size_t s = 0; s < cmd.elem_count; ++s)
+			{
+				const size_t idx = cmd.idx_offset + s;
+				cmd_indices[s] = weld[index_type == IndexType::UInt32 ? indices32[idx] - vtx_begin : indices[idx]];
+			}
+			optimizer.Optimize(cmd_indices.data(), cmd_indices.size(), vtx_count);
+
+			for (size_t s = 0; s < cmd.elem_count; ++s)
+			{
+				auto& dst = remap[cmd_indices[s]];
+				if (dst == NONE)
+				{
+					dst = static_cast<uint32_t>(dst_vertices.size() - dst_begin);
+					dst_vertices.push_back(src[cmd_indices[s]]);
+				}
+				const size_t idx = cmd.idx_offset + s;
+				if (index_type == IndexType::UInt32) {
+					indices32[idx] = static_cast<uint32_t>(dst_begin) + dst;
+				} else {
+					indices[idx] = static_cast<unsigned short>(dst);
+				}
+			}
+		}
+		for (size_t k = i; k < j; ++k) {
+			commands[k].vtx_offset = index_type == IndexType::UInt32 ? 0 : dst_begin;
+		}
+
+		i = j;
+	}
+
+	// in place, so the vertices stay in the sink's chunk
+	std::copy(dst_vertices.begin(), dst_vertices.end(), vertices.begin());
+	vertices.resize(dst_vertices.size());
+
+	vert_ptr    = vertices.data() + vertices.size();
+	index_ptr   = indices.data() + indices.size();
+	index32_ptr = indices32.data() + indices32.size();
+	curr_index  = commands.empty() ? 0 : static_cast<uint32_t>(vertices.size() - commands.back().vtx_offset);
+}
+
+void Painter::Buffer::Fit(size_t idx_count, size_t vtx_count)
+{
+	if (!sink || (vertices.size() + vtx_count <= vertices.capacity() && IndexCount() + idx_count <= IndexCapacity())) {
+		return;
+	}
+
+	FlushChunk();
 
-	size_t sz = vertices.size();
-	vertices.resize(sz + vtx_count);
-	vert_ptr = vertices.data() + sz;
+	auto chunk = sink->Acquire(index_type);
+	assert(index_type == IndexType::UInt32 || chunk.vtx_capacity <= MAX_VERTICES_16);
+	vertices.attach(chunk.vertices, chunk.vtx_capacity);
+	if (index_type == IndexType::UInt32) {
+		indices32.attach(static_cast<uint32_t*>(chunk.indices), chunk.idx_capacity);
+	} else {
+		indices.attach(static_cast<unsigned short*>(chunk.indices), chunk.idx_capacity);
+	}
+}
 
-	sz = indices.size();
-	indices.resize(sz + idx_count);
-	index_ptr = indices.data() + sz;
+void Painter::Buffer::FlushChunk()
+{
+	if (!commands.empty() && IndexCount() > 0) {
+		sink->Flush(*this);
+	}
+	flushed_vtx += vertices.size();
+	flushed_idx += IndexCount();
+
+	// the next Reserve() asks for a new chunk
+	Clear();
+	vertices.attach(nullptr, 0);
+	indices.attach(nullptr, 0);
+	indices32.attach(nullptr, 0);
 }
 
 void Painter::Buffer::Clear()
 {
-//	commands.resize(0);
-	vertices.resize(0);
-	indices.resize(0);
+	commands.clear();
+	vertices.clear();
+	indices.clear();
+	indices32.clear();
+
+	curr_index  = 0;
+	vert_ptr    = nullptr;
+	index_ptr   = nullptr;
+	index32_ptr = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// struct Painter::InstanceBuffer
+//////////////////////////////////////////////////////////////////////////
+
+void Painter::InstanceBuffer::Append(const InstanceBuffer& src, size_t idx_count)
+{
+	const size_t first = instances.size();
+	for (auto& cmd : src.commands)
+	{
+		commands.push_back(cmd);
+		commands.back().first     += first;
+		commands.back().idx_count += idx_count;
+	}
+
+	std::copy(src.instances.begin(), src.instances.end(), instances.append(src.instances.size()));
+}
+
+void Painter::InstanceBuffer::Clear()
+{
+	commands.clear();
+	instances.clear();
+}
+
+#if TESS_ENABLE_STATS
+
+//////////////////////////////////////////////////////////////////////////
+// Painter stats
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+Painter::ProfilerHooks PROFILER_HOOKS;
+
+int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+Painter::KindStats& Painter::KindStats::operator += (const KindStats& st)
+{
+	calls         += st.calls;
+	alpha_rejects += st.alpha_rejects;
+	vertices      += st.vertices;
+	indices       += st.indices;
+	reallocs      += st.reallocs;
+	bytes_moved   += st.bytes_moved;
+	time_ns       += st.time_ns;
+	return *this;
+}
+
+Painter::KindStats Painter::Stats::Total() const
+{
+	KindStats total;
+	for (auto& st : kinds) {
+		total += st;
+	}
+	return total;
+}
+
+const char* Painter::GetStatsKindName(StatsKind kind)
+{
+	static const char* const NAMES[] = {
+		"Line", "DashLine", "Rect", "RectFilled", "Circle", "CircleFilled", "Arc", "Triangle", "TriangleFilled",
+		"Polyline", "PolylineDash", "Polygon", "PolygonFilled", "Path", "PathFilled",
+		"Point3D", "Line3D", "Cube", "Arc3D", "Polyline3D", "Polygon3D", "PolygonFilled3D",
+		"TexQuad", "Painter",
+	};
+	static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == static_cast<size_t>(StatsKind::Count), "a name for each kind");
+	return kind < StatsKind::Count ? NAMES[static_cast<size_t>(kind)] : "";
+}
+
+void Painter::SetProfilerHooks(const ProfilerHooks& hooks)
+{
+	PROFILER_HOOKS = hooks;
+}
+
+Painter::StatsScope::StatsScope(Painter& pt, StatsKind kind)
+	: m_pt(pt)
+	, m_kind(kind)
+	, m_outer(pt.m_stats_depth++ == 0)
+{
+	if (!m_outer) {
+		return;
+	}
+
+	pt.m_stats_kind = kind;
+	if (PROFILER_HOOKS.begin) {
+		PROFILER_HOOKS.begin(GetStatsKindName(kind), PROFILER_HOOKS.user);
+	}
+
+	auto& buf = pt.m_buf;
+	m_vtx_begin = buf.TotalVertexCount();
+	m_idx_begin = buf.TotalIndexCount();
+	m_reallocs_begin    = buf.reallocs;
+	m_bytes_moved_begin = buf.bytes_moved;
+	m_time_begin = now_ns();
+}
+
+Painter::StatsScope::~StatsScope()
+{
+	--m_pt.m_stats_depth;
+	if (!m_outer) {
+		return;
+	}
 
-	curr_index = 0;
-	vert_ptr   = nullptr;
-	index_ptr  = nullptr;
+	auto& buf = m_pt.m_buf;
+	auto& st = m_pt.m_stats[m_kind];
+	++st.calls;
+	st.vertices    += buf.TotalVertexCount() - m_vtx_begin;
+	st.indices     += buf.TotalIndexCount() - m_idx_begin;
+	st.reallocs    += buf.reallocs - m_reallocs_begin;
+	st.bytes_moved += buf.bytes_moved - m_bytes_moved_begin;
+	st.time_ns     += now_ns() - m_time_begin;
+
+	if (PROFILER_HOOKS.end) {
+		PROFILER_HOOKS.end(GetStatsKindName(m_kind), PROFILER_HOOKS.user);
+	}
 }
 
-}
\ No newline at end of file
+#endif // TESS_ENABLE_STATS
+
+}
@@ -0,0 +1,46 @@
+#include "tessellation/PainterPool.h"
+
+#include <algorithm>
+
+namespace tess
+{
+
+PainterPool::PainterPool(IndexType index_type)
+	: m_index_type(index_type)
+{
+}
+
+Painter PainterPool::Acquire()
+{
+	Painter pt(m_index_type);
+	if (!m_free.empty())
+	{
+		pt = std::move(m_free.back());
+		m_free.pop_back();
+	}
+	// only allocates while the high-water mark still rises
+	pt.Preallocate(m_capacity_hint);
+	return pt;
+}
+
+void PainterPool::Release(Painter&& pt)
+{
+	auto& buf = pt.GetBuffer();
+	if (buf.index_type != m_index_type) {
+		return;
+	}
+
+	m_capacity_hint.vtx_count = std::max(m_capacity_hint.vtx_count, buf.vertices.size());
+	m_capacity_hint.idx_count = std::max(m_capacity_hint.idx_count, buf.IndexCount());
+
+	pt.Clear();
+	m_free.push_back(std::move(pt));
+}
+
+void PainterPool::Clear()
+{
+	m_free.clear();
+	m_capacity_hint = MeshSize();
+}
+
+}
@@ -0,0 +1,135 @@
+#include "tessellation/ParallelPainter.h"
+#include "tessellation/Shape.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const size_t MIN_SHAPES_PER_CHUNK = 64;
+const size_t CHUNKS_PER_THREAD    = 8;
+
+}
+
+namespace tess
+{
+
+ParallelPainter::ParallelPainter(size_t thread_num)
+	: m_pool(thread_num)
+{
+}
+
+void ParallelPainter::AddShapes(const Shape* shapes, size_t count, Painter& dst)
+{
+	if (count == 0) {
+		return;
+	}
+
+	// enough chunks for the workers to steal from each other
+	const size_t chunk_size = std::max(MIN_SHAPES_PER_CHUNK,
+		(count + m_pool.GetThreadNum() * CHUNKS_PER_THREAD - 1) / (m_pool.GetThreadNum() * CHUNKS_PER_THREAD));
+	const size_t chunk_num = (count + chunk_size - 1) / chunk_size;
+
+	auto& dst_buf = dst.GetBuffer();
+	if (m_chunks.size() < chunk_num) {
+		m_chunks.resize(chunk_num, Painter(dst_buf.index_type));
+	}
+	const bool pack = dst_buf.index_type == IndexType::UInt16 && !dst.GetOutputSink();
+	if (pack && m_reservations.size() < chunk_num)
+	{
+		m_reservations.resize(chunk_num);
+		m_placements.resize(chunk_num);
+	}
+	for (size_t i = 0; i < chunk_num; ++i)
+	{
+		auto& pt = m_chunks[i];
+		if (pt.GetBuffer().index_type != dst_buf.index_type) {
+			pt = Painter(dst_buf.index_type);
+		}
+		pt.Clear();
+		pt.SetFlags(dst.GetFlags());
+		pt.SetPalette(dst.GetPalette());
+		pt.SetCircleMaxError(dst.GetCircleMaxError());
+		pt.SetPolylineMaxError(dst.GetPolylineMaxError());
+		pt.EnableShapeCache(dst.IsShapeCacheEnabled());
+		pt.EnableInstancing(dst.IsInstancingEnabled());
+		if (dst_buf.curr_clip_rect.IsValid()) {
+			pt.PushClipRect(dst_buf.curr_clip_rect);
+		}
+		if (pack) {
+			m_reservations[i].clear();
+		}
+		pt.LogReservations(pack ? &m_reservations[i] : nullptr);
+	}
+
+	m_pool.ParallelFor(chunk_num, [&](size_t i)
+	{
+		auto& pt = m_chunks[i];
+		for (size_t j = i * chunk_size, end = std::min(count, j + chunk_size); j < end; ++j) {
+			pt.AddShape(shapes[j]);
+		}
+	});
+
+	// the chunks of a sink have a fixed size, Resize() would build everything in dst's own memory
+	if (dst.GetOutputSink())
+	{
+		for (size_t i = 0; i < chunk_num; ++i) {
+			dst.AddPainter(m_chunks[i]);
+		}
+		return;
+	}
+
+	// prefix sums give each chunk its place in dst
+	m_vtx_offsets.resize(chunk_num);
+	m_idx_offsets.resize(chunk_num);
+	m_cmd_offsets.resize(chunk_num);
+	size_t vtx_count = dst_buf.vertices.size(),
+	       idx_count = dst_buf.IndexCount(),
+	       cmd_count = dst_buf.commands.size();
+	for (size_t i = 0; i < chunk_num; ++i)
+	{
+		m_vtx_offsets[i] = vtx_count;
+		m_idx_offsets[i] = idx_count;
+		m_cmd_offsets[i] = cmd_count;
+
+		if (m_chunks[i].GetBuffer().IndexCount() > 0)
+		{
+			MeshSize size;
+			size_t cmds = 0;
+			dst.CalcPainterSize(m_chunks[i], size, cmds);
+			vtx_count += size.vtx_count;
+			idx_count += size.idx_count;
+			cmd_count += cmds;
+		}
+	}
+	if (pack && vtx_count > dst_buf.vertices.size())
+	{
+		// the blocks serial Reserve() calls would open, each chunk's indices moved to them
+		MeshSize size;
+		size.vtx_count = vtx_count - dst_buf.vertices.size();
+		size.idx_count = idx_count - dst_buf.IndexCount();
+		dst.Preallocate(size);
+		for (size_t i = 0; i < chunk_num; ++i) {
+			dst.PackPainter(m_chunks[i], m_reservations[i], m_placements[i]);
+		}
+		m_pool.ParallelFor(chunk_num, [&](size_t i) {
+			dst.FillPacked(m_chunks[i], m_placements[i]);
+		});
+	}
+	else if (vtx_count > dst_buf.vertices.size())
+	{
+		dst.Resize(vtx_count, idx_count, cmd_count);
+		m_pool.ParallelFor(chunk_num, [&](size_t i) {
+			dst.FillPainter(m_chunks[i], m_vtx_offsets[i], m_idx_offsets[i], m_cmd_offsets[i]);
+		});
+
+		dst.MergeCommands();
+	}
+
+	// after the triangles in front of them, in chunk order
+	for (size_t i = 0; i < chunk_num; ++i) {
+		dst.AddInstances(m_chunks[i], m_idx_offsets[i]);
+	}
+}
+
+}
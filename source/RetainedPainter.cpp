@@ -0,0 +1,234 @@
+#include "tessellation/RetainedPainter.h"
+#include "tessellation/Shape.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tess
+{
+
+RetainedPainter::RetainedPainter()
+	: m_buf(IndexType::UInt32)
+	, m_tess(IndexType::UInt32)
+{
+}
+
+RetainedPainter::Handle RetainedPainter::Add(const Shape& shape)
+{
+	Tessellate(shape);
+
+	Handle handle;
+	auto itr = std::find_if(m_free.begin(), m_free.end(), [&](Handle h) {
+		return Fits(m_slots[h]);
+	});
+	if (itr != m_free.end())
+	{
+		handle = *itr;
+		*itr = m_free.back();
+		m_free.pop_back();
+		m_unused_vtx -= m_slots[handle].vtx_cap;
+	}
+	else
+	{
+		// reuse the handle only, the old slot stays unused until Compact()
+		if (m_free.empty()) {
+			handle = static_cast<Handle>(m_slots.size());
+			m_slots.push_back(Slot());
+		} else {
+			handle = m_free.back();
+			m_free.pop_back();
+		}
+		AppendSlot(m_slots[handle]);
+	}
+
+	auto& slot = m_slots[handle];
+	slot.alive = true;
+	WriteSlot(slot);
+
+	return handle;
+}
+
+void RetainedPainter::Update(Handle handle, const Shape& shape)
+{
+	if (handle >= m_slots.size() || !m_slots[handle].alive) {
+		return;
+	}
+
+	Tessellate(shape);
+
+	auto& slot = m_slots[handle];
+	if (!Fits(slot))
+	{
+		ClearSlot(slot);
+		m_unused_vtx += slot.vtx_cap;
+		AppendSlot(slot);
+	}
+	WriteSlot(slot);
+}
+
+void RetainedPainter::Remove(Handle handle)
+{
+	if (handle >= m_slots.size() || !m_slots[handle].alive) {
+		return;
+	}
+
+	auto& slot = m_slots[handle];
+	ClearSlot(slot);
+	slot.alive = false;
+	m_unused_vtx += slot.vtx_cap;
+	m_free.push_back(handle);
+}
+
+void RetainedPainter::Clear()
+{
+	m_buf.Clear();
+	m_slots.clear();
+	m_free.clear();
+	m_unused_vtx = 0;
+	m_dirty_vtx.clear();
+	m_dirty_idx.clear();
+}
+
+void RetainedPainter::Compact()
+{
+	// slots only move towards the front, so copying them in buffer order is safe in place
+	std::vector<Handle> live;
+	live.reserve(m_slots.size());
+	for (Handle i = 0, n = static_cast<Handle>(m_slots.size()); i < n; ++i)
+	{
+		if (m_slots[i].alive) {
+			live.push_back(i);
+		} else {
+			m_slots[i] = Slot();
+		}
+	}
+	std::sort(live.begin(), live.end(), [&](Handle a, Handle b) {
+		return m_slots[a].vtx_off < m_slots[b].vtx_off;
+	});
+
+	size_t vtx_off = 0, idx_off = 0;
+	for (auto h : live)
+	{
+		auto& slot = m_slots[h];
+		std::memmove(&m_buf.vertices[vtx_off], &m_buf.vertices[slot.vtx_off], slot.vtx_count * sizeof(Painter::Vertex));
+		const uint32_t old_base = static_cast<uint32_t>(slot.vtx_off);
+		const uint32_t new_base = static_cast<uint32_t>(vtx_off);
+		for (size_t i = 0; i < slot.idx_count; ++i) {
+			m_buf.indices32[idx_off + i] = m_buf.indices32[slot.idx_off + i] - old_base + new_base;
+		}
+
+		slot.vtx_off = vtx_off;
+		slot.idx_off = idx_off;
+		slot.vtx_cap = slot.vtx_count;
+		slot.idx_cap = slot.idx_count;
+		vtx_off += slot.vtx_count;
+		idx_off += slot.idx_count;
+	}
+
+	m_buf.vertices.resize(vtx_off);
+	m_buf.indices32.resize(idx_off);
+	if (!m_buf.commands.empty()) {
+		m_buf.commands.back().elem_count = idx_off;
+	}
+	m_buf.curr_index  = static_cast<uint32_t>(vtx_off);
+	m_buf.vert_ptr    = m_buf.vertices.data() + vtx_off;
+	m_buf.index32_ptr = m_buf.indices32.data() + idx_off;
+
+	m_unused_vtx = 0;
+
+	m_dirty_vtx.clear();
+	m_dirty_idx.clear();
+	AddDirty(m_dirty_vtx, 0, vtx_off * sizeof(Painter::Vertex));
+	AddDirty(m_dirty_idx, 0, idx_off * sizeof(uint32_t));
+}
+
+void RetainedPainter::TakeDirtyRanges(std::vector<Range>& vertex_ranges, std::vector<Range>& index_ranges)
+{
+	auto merge = [](std::vector<Range>& src, std::vector<Range>& dst)
+	{
+		dst.clear();
+		std::sort(src.begin(), src.end(), [](const Range& a, const Range& b) {
+			return a.begin < b.begin;
+		});
+		for (auto& r : src)
+		{
+			if (!dst.empty() && r.begin <= dst.back().end) {
+				dst.back().end = std::max(dst.back().end, r.end);
+			} else {
+				dst.push_back(r);
+			}
+		}
+		src.clear();
+	};
+	merge(m_dirty_vtx, vertex_ranges);
+	merge(m_dirty_idx, index_ranges);
+}
+
+void RetainedPainter::Tessellate(const Shape& shape)
+{
+	m_tess.Clear();
+	m_tess.AddShape(shape);
+}
+
+bool RetainedPainter::Fits(const Slot& slot) const
+{
+	auto& buf = m_tess.GetBuffer();
+	return buf.vertices.size() <= slot.vtx_cap && buf.indices32.size() <= slot.idx_cap;
+}
+
+void RetainedPainter::AppendSlot(Slot& slot)
+{
+	auto& buf = m_tess.GetBuffer();
+	slot.vtx_off = m_buf.vertices.size();
+	slot.idx_off = m_buf.indices32.size();
+	slot.vtx_cap = buf.vertices.size();
+	slot.idx_cap = buf.indices32.size();
+	m_buf.Reserve(slot.idx_cap, slot.vtx_cap);
+	m_buf.curr_index += static_cast<uint32_t>(slot.vtx_cap);
+}
+
+void RetainedPainter::WriteSlot(Slot& slot)
+{
+	auto& buf = m_tess.GetBuffer();
+	const size_t vtx_count = buf.vertices.size();
+	const size_t idx_count = buf.indices32.size();
+	slot.vtx_count = vtx_count;
+	slot.idx_count = idx_count;
+
+	if (vtx_count > 0) {
+		std::memcpy(&m_buf.vertices[slot.vtx_off], buf.vertices.data(), vtx_count * sizeof(Painter::Vertex));
+	}
+
+	const uint32_t base = static_cast<uint32_t>(slot.vtx_off);
+	uint32_t* dst = m_buf.indices32.data() + slot.idx_off;
+	for (size_t i = 0; i < idx_count; ++i) {
+		dst[i] = buf.indices32[i] + base;
+	}
+	std::fill(dst + idx_count, dst + slot.idx_cap, base);
+
+	AddDirty(m_dirty_vtx, slot.vtx_off * sizeof(Painter::Vertex), (slot.vtx_off + vtx_count) * sizeof(Painter::Vertex));
+	AddDirty(m_dirty_idx, slot.idx_off * sizeof(uint32_t), (slot.idx_off + slot.idx_cap) * sizeof(uint32_t));
+}
+
+void RetainedPainter::ClearSlot(const Slot& slot)
+{
+	uint32_t* dst = m_buf.indices32.data() + slot.idx_off;
+	std::fill(dst, dst + slot.idx_cap, static_cast<uint32_t>(slot.vtx_off));
+	AddDirty(m_dirty_idx, slot.idx_off * sizeof(uint32_t), (slot.idx_off + slot.idx_cap) * sizeof(uint32_t));
+}
+
+void RetainedPainter::AddDirty(std::vector<Range>& ranges, size_t begin, size_t end)
+{
+	if (begin == end) {
+		return;
+	}
+
+	// most updates come in buffer order, extend the last range when they touch
+	if (!ranges.empty() && ranges.back().end == begin) {
+		ranges.back().end = end;
+	} else {
+		ranges.push_back({ begin, end });
+	}
+}
+
+}
@@ -0,0 +1,169 @@
+#include "tessellation/Shape.h"
+
+namespace tess
+{
+
+Shape Shape::Line(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width)
+{
+	Shape s;
+	s.type       = ShapeType::Line;
+	s.p0         = p0;
+	s.p1         = p1;
+	s.col        = col;
+	s.line_width = line_width;
+	return s;
+}
+
+Shape Shape::DashLine(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float step_len)
+{
+	Shape s;
+	s.type       = ShapeType::DashLine;
+	s.p0         = p0;
+	s.p1         = p1;
+	s.col        = col;
+	s.line_width = line_width;
+	s.step_len   = step_len;
+	return s;
+}
+
+Shape Shape::Rect(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float line_width, float rounding, uint32_t rounding_corners_flags)
+{
+	Shape s;
+	s.type       = ShapeType::Rect;
+	s.p0         = p0;
+	s.p1         = p1;
+	s.col        = col;
+	s.line_width = line_width;
+	s.rounding   = rounding;
+	s.rounding_corners_flags = rounding_corners_flags;
+	return s;
+}
+
+Shape Shape::RectFilled(const sm::vec2& p0, const sm::vec2& p1, uint32_t col, float rounding, uint32_t rounding_corners_flags)
+{
+	Shape s;
+	s.type     = ShapeType::RectFilled;
+	s.p0       = p0;
+	s.p1       = p1;
+	s.col      = col;
+	s.rounding = rounding;
+	s.rounding_corners_flags = rounding_corners_flags;
+	return s;
+}
+
+Shape Shape::Circle(const sm::vec2& centre, float radius, uint32_t col, float line_width, uint32_t num_segments)
+{
+	Shape s;
+	s.type         = ShapeType::Circle;
+	s.p0           = centre;
+	s.radius       = radius;
+	s.col          = col;
+	s.line_width   = line_width;
+	s.num_segments = num_segments;
+	return s;
+}
+
+Shape Shape::CircleFilled(const sm::vec2& centre, float radius, uint32_t col, uint32_t num_segments)
+{
+	Shape s;
+	s.type         = ShapeType::CircleFilled;
+	s.p0           = centre;
+	s.radius       = radius;
+	s.col          = col;
+	s.num_segments = num_segments;
+	return s;
+}
+
+Shape Shape::Arc(const sm::vec2& centre, float radius, float start_angle, float end_angle, uint32_t col, float line_width, uint32_t num_segments)
+{
+	Shape s;
+	s.type         = ShapeType::Arc;
+	s.p0           = centre;
+	s.radius       = radius;
+	s.start_angle  = start_angle;
+	s.end_angle    = end_angle;
+	s.col          = col;
+	s.line_width   = line_width;
+	s.num_segments = num_segments;
+	return s;
+}
+
+Shape Shape::Triangle(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col, float line_width)
+{
+	Shape s;
+	s.type       = ShapeType::Triangle;
+	s.p0         = p0;
+	s.p1         = p1;
+	s.p2         = p2;
+	s.col        = col;
+	s.line_width = line_width;
+	return s;
+}
+
+Shape Shape::TriangleFilled(const sm::vec2& p0, const sm::vec2& p1, const sm::vec2& p2, uint32_t col)
+{
+	Shape s;
+	s.type = ShapeType::TriangleFilled;
+	s.p0   = p0;
+	s.p1   = p1;
+	s.p2   = p2;
+	s.col  = col;
+	return s;
+}
+
+Shape Shape::Polyline(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+{
+	Shape s;
+	s.type       = ShapeType::Polyline;
+	s.points     = points;
+	s.count      = count;
+	s.col        = col;
+	s.line_width = line_width;
+	return s;
+}
+
+Shape Shape::PolylineMultiColor(const sm::vec2* points, const uint32_t* cols, size_t count, float line_width)
+{
+	Shape s;
+	s.type       = ShapeType::PolylineMultiColor;
+	s.points     = points;
+	s.cols       = cols;
+	s.count      = count;
+	s.line_width = line_width;
+	return s;
+}
+
+Shape Shape::PolylineDash(const sm::vec2* points, size_t count, uint32_t col, float line_width, float step_len)
+{
+	Shape s;
+	s.type       = ShapeType::PolylineDash;
+	s.points     = points;
+	s.count      = count;
+	s.col        = col;
+	s.line_width = line_width;
+	s.step_len   = step_len;
+	return s;
+}
+
+Shape Shape::Polygon(const sm::vec2* points, size_t count, uint32_t col, float line_width)
+{
+	Shape s;
+	s.type       = ShapeType::Polygon;
+	s.points     = points;
+	s.count      = count;
+	s.col        = col;
+	s.line_width = line_width;
+	return s;
+}
+
+Shape Shape::PolygonFilled(const sm::vec2* points, size_t count, uint32_t col)
+{
+	Shape s;
+	s.type   = ShapeType::PolygonFilled;
+	s.points = points;
+	s.count  = count;
+	s.col    = col;
+	return s;
+}
+
+}
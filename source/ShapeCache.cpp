@@ -0,0 +1,101 @@
+#include "tessellation/ShapeCache.h"
+
+#include <cstring>
+
+namespace tess
+{
+
+static_assert(sizeof(ShapeCache::Key) == sizeof(uint32_t) * 8, "ShapeCache::Key has padding");
+
+//////////////////////////////////////////////////////////////////////////
+// struct ShapeCache::Key
+//////////////////////////////////////////////////////////////////////////
+
+ShapeCache::Key::Key(Kind kind, uint32_t flags, uint32_t segments, uint32_t corners,
+	                 const sm::vec2& size, float rounding, float line_width)
+	: kind(kind)
+	, flags(flags)
+	, segments(segments)
+	, corners(corners)
+	, rounding(rounding)
+	, line_width(line_width)
+{
+	this->size[0] = size.x;
+	this->size[1] = size.y;
+}
+
+bool ShapeCache::Key::operator == (const Key& key) const
+{
+	return std::memcmp(this, &key, sizeof(Key)) == 0;
+}
+
+size_t ShapeCache::KeyHash::operator () (const Key& key) const
+{
+	// FNV-1a over the 32-bit words
+	uint32_t words[sizeof(Key) / sizeof(uint32_t)];
+	std::memcpy(words, &key, sizeof(Key));
+
+	size_t h = 2166136261u;
+	for (auto w : words) {
+		h = (h ^ w) * 16777619u;
+	}
+	return h;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// class ShapeCache
+//////////////////////////////////////////////////////////////////////////
+
+bool ShapeCache::Query(const Key& key, Mesh& mesh)
+{
+	auto itr = m_entries.find(key);
+	if (itr == m_entries.end()) {
+		return false;
+	}
+
+	mesh = MakeMesh(itr->second);
+	return true;
+}
+
+ShapeCache::Mesh ShapeCache::Insert(const Key& key, size_t vtx_count, size_t idx_count)
+{
+	if (m_entries.size() >= MAX_ENTRIES) {
+		Clear();
+	}
+
+	Entry entry;
+	entry.vtx_off   = m_positions.size();
+	entry.vtx_count = vtx_count;
+	entry.idx_off   = m_indices.size();
+	entry.idx_count = idx_count;
+	m_positions.append(vtx_count);
+	m_col_masks.append(vtx_count);
+	m_edges.append(vtx_count);
+	m_indices.append(idx_count);
+
+	m_entries[key] = entry;
+	return MakeMesh(entry);
+}
+
+void ShapeCache::Clear()
+{
+	m_entries.clear();
+	m_positions.clear();
+	m_col_masks.clear();
+	m_edges.clear();
+	m_indices.clear();
+}
+
+ShapeCache::Mesh ShapeCache::MakeMesh(const Entry& entry)
+{
+	Mesh mesh;
+	mesh.positions = m_positions.data() + entry.vtx_off;
+	mesh.col_masks = m_col_masks.data() + entry.vtx_off;
+	mesh.edges     = m_edges.data() + entry.vtx_off;
+	mesh.indices   = m_indices.data() + entry.idx_off;
+	mesh.vtx_count = entry.vtx_count;
+	mesh.idx_count = entry.idx_count;
+	return mesh;
+}
+
+}
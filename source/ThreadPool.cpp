@@ -0,0 +1,120 @@
+#include "tessellation/ThreadPool.h"
+
+#include <algorithm>
+
+namespace tess
+{
+
+ThreadPool::ThreadPool(size_t thread_num)
+{
+	if (thread_num == 0) {
+		thread_num = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_ranges.reset(new Range[thread_num]);
+	for (size_t i = 0; i < thread_num; ++i) {
+		m_ranges[i].next = 0;
+	}
+
+	// worker 0 is the thread calling ParallelFor()
+	for (size_t i = 1; i < thread_num; ++i) {
+		m_threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start_cv.notify_all();
+	for (auto& t : m_threads) {
+		t.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if (count == 0) {
+		return;
+	}
+	if (m_threads.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			func(i);
+		}
+		return;
+	}
+
+	const size_t worker_num = GetThreadNum();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < worker_num; ++i)
+		{
+			m_ranges[i].next = count * i / worker_num;
+			m_ranges[i].end  = count * (i + 1) / worker_num;
+		}
+		m_func      = &func;
+		m_exception = nullptr;
+		m_pending   = m_threads.size();
+		++m_generation;
+	}
+	m_start_cv.notify_all();
+
+	Run(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_cv.wait(lock, [this] { return m_pending == 0; });
+	m_func = nullptr;
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+}
+
+void ThreadPool::WorkerLoop(size_t id)
+{
+	size_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start_cv.wait(lock, [&] { return m_stop || m_generation != generation; });
+			if (m_stop) {
+				return;
+			}
+			generation = m_generation;
+		}
+
+		Run(id);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_pending;
+		}
+		m_done_cv.notify_one();
+	}
+}
+
+void ThreadPool::Run(size_t id)
+{
+	const size_t worker_num = GetThreadNum();
+	// drain the own range first, then steal from the others
+	for (size_t i = 0; i < worker_num; ++i)
+	{
+		auto& range = m_ranges[(id + i) % worker_num];
+		for (size_t idx = range.next.fetch_add(1); idx < range.end; idx = range.next.fetch_add(1))
+		{
+			try {
+				(*m_func)(idx);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_exception) {
+					m_exception = std::current_exception();
+				}
+			}
+		}
+	}
+}
+
+}
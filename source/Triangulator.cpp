@@ -0,0 +1,692 @@
+#include "tessellation/Triangulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+inline float cross(const sm::vec2& o, const sm::vec2& a, const sm::vec2& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+}
+
+namespace tess
+{
+
+const uint32_t Triangulator::NONE;
+
+void Triangulator::Begin()
+{
+	m_points.clear();
+	m_point_contours.clear();
+	m_contours.clear();
+	m_indices.clear();
+}
+
+void Triangulator::AddContour(const sm::vec2* points, size_t count)
+{
+	const size_t begin = m_points.size();
+	const uint32_t contour = static_cast<uint32_t>(m_contours.size());
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& p = points[i];
+		if (!std::isfinite(p.x) || !std::isfinite(p.y)) {
+			continue;
+		}
+		if (m_points.size() > begin && m_points.back().x == p.x && m_points.back().y == p.y) {
+			continue;
+		}
+		m_points.push_back(p);
+		m_point_contours.push_back(contour);
+	}
+	// the closing point is often the first one again
+	while (m_points.size() > begin + 1 && m_points.back().x == m_points[begin].x && m_points.back().y == m_points[begin].y)
+	{
+		m_points.resize(m_points.size() - 1);
+		m_point_contours.resize(m_point_contours.size() - 1);
+	}
+
+	const size_t n = m_points.size() - begin;
+	if (n < 3)
+	{
+		m_points.resize(begin);
+		m_point_contours.resize(begin);
+		return;
+	}
+
+	Contour c;
+	c.begin   = begin;
+	c.count   = n;
+	c.outside = 0;
+	m_contours.push_back(c);
+}
+
+void Triangulator::Triangulate(FillRule rule)
+{
+	m_rule = rule;
+	m_indices.clear();
+	m_edges.clear();
+	m_nodes.clear();
+	m_free_edges.clear();
+	m_root = NONE;
+	m_seed = 1;
+	m_crossings = false;
+
+	const uint32_t n = static_cast<uint32_t>(m_points.size());
+	m_segment_edges.resize(n);
+	std::fill(m_segment_edges.begin(), m_segment_edges.end(), NONE);
+	m_order.resize(n);
+	for (uint32_t i = 0; i < n; ++i) {
+		m_order[i] = i;
+	}
+	std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+		return IsBelow(b, a);
+	});
+
+	for (auto v : m_order)
+	{
+		auto& c = m_contours[m_point_contours[v]];
+		const uint32_t last = static_cast<uint32_t>(c.begin + c.count - 1);
+		const uint32_t prev = v == c.begin ? last : v - 1;
+		const uint32_t next = v == last ? static_cast<uint32_t>(c.begin) : v + 1;
+
+		const bool prev_below = IsBelow(prev, v);
+		const bool next_below = IsBelow(next, v);
+		if (prev_below && next_below) {
+			StartVertex(v, prev, next);
+		} else if (!prev_below && !next_below) {
+			EndVertex(v, prev, next);
+		} else if (prev_below) {
+			RegularVertex(v, next, prev);
+		} else {
+			RegularVertex(v, prev, next);
+		}
+	}
+
+	// only left over by crossing contours
+	for (uint32_t id = First(); id != NONE; id = Next(id))
+	{
+		auto& e = m_edges[id];
+		if (e.poly != NONE) {
+			m_free_polys.push_back(e.poly);
+		}
+		if (e.merge_poly != NONE) {
+			m_free_polys.push_back(e.merge_poly);
+		}
+		m_crossings = true;
+	}
+	m_root = NONE;
+}
+
+// sweeps down in y, then right in x on the same row
+bool Triangulator::IsBelow(uint32_t a, uint32_t b) const
+{
+	auto& pa = m_points[a];
+	auto& pb = m_points[b];
+	if (pa.y != pb.y) {
+		return pa.y > pb.y;
+	}
+	if (pa.x != pb.x) {
+		return pa.x > pb.x;
+	}
+	return a > b;
+}
+
+bool Triangulator::IsLeftOf(uint32_t v, const Edge& e) const
+{
+	return cross(m_points[e.top], m_points[e.bot], m_points[v]) > 0;
+}
+
+uint32_t Triangulator::Segment(uint32_t a, uint32_t b) const
+{
+	auto& c = m_contours[m_point_contours[a]];
+	const uint32_t next = a + 1 == c.begin + c.count ? static_cast<uint32_t>(c.begin) : a + 1;
+	return next == b ? a : b;
+}
+
+uint32_t Triangulator::FindEdge(uint32_t top, uint32_t bot) const
+{
+	const uint32_t id = m_segment_edges[Segment(top, bot)];
+	if (id != NONE && m_edges[id].top == top && m_edges[id].bot == bot) {
+		return id;
+	}
+	return NONE;
+}
+
+uint32_t Triangulator::FindSpan(uint32_t edge) const
+{
+	// linear in the edges between two boundaries, only the nonzero rule has them
+	for (uint32_t id = edge; id != NONE; id = Prev(id))
+	{
+		auto& e = m_edges[id];
+		if (e.boundary) {
+			return e.inside ? id : NONE;
+		}
+	}
+	return NONE;
+}
+
+void Triangulator::CheckCrossing(uint32_t left, uint32_t right)
+{
+	if (left == NONE || right == NONE) {
+		return;
+	}
+
+	// touching at the ends or lying on one another is fine, only proper crossings count
+	auto& a = m_edges[left];
+	auto& b = m_edges[right];
+	auto& a0 = m_points[a.top];
+	auto& a1 = m_points[a.bot];
+	auto& b0 = m_points[b.top];
+	auto& b1 = m_points[b.bot];
+	const float c0 = cross(a0, a1, b0);
+	const float c1 = cross(a0, a1, b1);
+	const float c2 = cross(b0, b1, a0);
+	const float c3 = cross(b0, b1, a1);
+	if (((c0 > 0 && c1 < 0) || (c0 < 0 && c1 > 0)) && ((c2 > 0 && c3 < 0) || (c2 < 0 && c3 > 0))) {
+		m_crossings = true;
+	}
+}
+
+uint32_t Triangulator::NewEdge(const Edge& e)
+{
+	uint32_t id;
+	if (m_free_edges.empty())
+	{
+		id = static_cast<uint32_t>(m_edges.size());
+		m_edges.push_back(e);
+		m_nodes.push_back(Node());
+	}
+	else
+	{
+		id = m_free_edges.back();
+		m_free_edges.resize(m_free_edges.size() - 1);
+		m_edges[id] = e;
+	}
+
+	// xorshift, the priorities only have to look random
+	m_seed ^= m_seed << 13;
+	m_seed ^= m_seed >> 17;
+	m_seed ^= m_seed << 5;
+
+	auto& node = m_nodes[id];
+	node.left = node.right = node.parent = NONE;
+	node.size     = 1;
+	node.priority = m_seed;
+
+	m_segment_edges[Segment(e.top, e.bot)] = id;
+	return id;
+}
+
+uint32_t Triangulator::LowerBound(uint32_t v) const
+{
+	uint32_t ret = NONE;
+	uint32_t t = m_root;
+	while (t != NONE)
+	{
+		if (IsLeftOf(v, m_edges[t])) {
+			ret = t;
+			t = m_nodes[t].left;
+		} else {
+			t = m_nodes[t].right;
+		}
+	}
+	return ret;
+}
+
+uint32_t Triangulator::First() const
+{
+	uint32_t t = m_root;
+	while (t != NONE && m_nodes[t].left != NONE) {
+		t = m_nodes[t].left;
+	}
+	return t;
+}
+
+uint32_t Triangulator::Last() const
+{
+	uint32_t t = m_root;
+	while (t != NONE && m_nodes[t].right != NONE) {
+		t = m_nodes[t].right;
+	}
+	return t;
+}
+
+uint32_t Triangulator::Prev(uint32_t edge) const
+{
+	uint32_t t = m_nodes[edge].left;
+	if (t != NONE)
+	{
+		while (m_nodes[t].right != NONE) {
+			t = m_nodes[t].right;
+		}
+		return t;
+	}
+	t = edge;
+	uint32_t p = m_nodes[t].parent;
+	while (p != NONE && m_nodes[p].left == t) {
+		t = p;
+		p = m_nodes[p].parent;
+	}
+	return p;
+}
+
+uint32_t Triangulator::Next(uint32_t edge) const
+{
+	uint32_t t = m_nodes[edge].right;
+	if (t != NONE)
+	{
+		while (m_nodes[t].left != NONE) {
+			t = m_nodes[t].left;
+		}
+		return t;
+	}
+	t = edge;
+	uint32_t p = m_nodes[t].parent;
+	while (p != NONE && m_nodes[p].right == t) {
+		t = p;
+		p = m_nodes[p].parent;
+	}
+	return p;
+}
+
+uint32_t Triangulator::Rank(uint32_t edge) const
+{
+	auto size = [&](uint32_t t) { return t == NONE ? 0 : m_nodes[t].size; };
+	uint32_t ret = size(m_nodes[edge].left);
+	for (uint32_t t = edge, p = m_nodes[t].parent; p != NONE; t = p, p = m_nodes[p].parent)
+	{
+		if (m_nodes[p].right == t) {
+			ret += size(m_nodes[p].left) + 1;
+		}
+	}
+	return ret;
+}
+
+void Triangulator::Insert(uint32_t v, uint32_t l, uint32_t r)
+{
+	uint32_t left, right;
+	Split(m_root, v, left, right);
+	m_root = Merge(Merge(left, Merge(l, r)), right);
+	m_nodes[m_root].parent = NONE;
+}
+
+void Triangulator::Erase(uint32_t edge)
+{
+	auto& node = m_nodes[edge];
+	const uint32_t child = Merge(node.left, node.right);
+	const uint32_t parent = node.parent;
+	if (child != NONE) {
+		m_nodes[child].parent = parent;
+	}
+	if (parent == NONE) {
+		m_root = child;
+	} else if (m_nodes[parent].left == edge) {
+		m_nodes[parent].left = child;
+	} else {
+		m_nodes[parent].right = child;
+	}
+	for (uint32_t t = parent; t != NONE; t = m_nodes[t].parent) {
+		--m_nodes[t].size;
+	}
+
+	auto& e = m_edges[edge];
+	auto& seg = m_segment_edges[Segment(e.top, e.bot)];
+	if (seg == edge) {
+		seg = NONE;
+	}
+	m_free_edges.push_back(edge);
+}
+
+void Triangulator::Split(uint32_t t, uint32_t v, uint32_t& left, uint32_t& right)
+{
+	if (t == NONE)
+	{
+		left = right = NONE;
+		return;
+	}
+
+	auto& node = m_nodes[t];
+	if (IsLeftOf(v, m_edges[t]))
+	{
+		uint32_t child;
+		Split(node.left, v, left, child);
+		node.left = child;
+		if (child != NONE) {
+			m_nodes[child].parent = t;
+		}
+		right = t;
+	}
+	else
+	{
+		uint32_t child;
+		Split(node.right, v, child, right);
+		node.right = child;
+		if (child != NONE) {
+			m_nodes[child].parent = t;
+		}
+		left = t;
+	}
+	UpdateSize(t);
+}
+
+uint32_t Triangulator::Merge(uint32_t left, uint32_t right)
+{
+	if (left == NONE) {
+		return right;
+	}
+	if (right == NONE) {
+		return left;
+	}
+
+	if (m_nodes[left].priority > m_nodes[right].priority)
+	{
+		const uint32_t child = Merge(m_nodes[left].right, right);
+		m_nodes[left].right = child;
+		m_nodes[child].parent = left;
+		UpdateSize(left);
+		return left;
+	}
+	else
+	{
+		const uint32_t child = Merge(left, m_nodes[right].left);
+		m_nodes[right].left = child;
+		m_nodes[child].parent = right;
+		UpdateSize(right);
+		return right;
+	}
+}
+
+void Triangulator::UpdateSize(uint32_t t)
+{
+	auto& node = m_nodes[t];
+	node.size = 1;
+	if (node.left != NONE) {
+		node.size += m_nodes[node.left].size;
+	}
+	if (node.right != NONE) {
+		node.size += m_nodes[node.right].size;
+	}
+}
+
+void Triangulator::StartVertex(uint32_t v, uint32_t prev, uint32_t next)
+{
+	const uint32_t after = LowerBound(v);
+	const uint32_t before = after == NONE ? Last() : Prev(after);
+	const int winding = before != NONE ? m_edges[before].winding : 0;
+
+	// the contour goes up to v and down from it
+	const bool next_left = cross(m_points[v], m_points[prev], m_points[next]) > 0;
+	Edge l = next_left ? MakeEdge(v, next, winding, 1) : MakeEdge(v, prev, winding, -1);
+	Edge r = next_left ? MakeEdge(v, prev, l.winding, -1) : MakeEdge(v, next, l.winding, 1);
+	SetContourOutside(l, next_left ? 1 : -1);
+
+	if (l.boundary)
+	{
+		if (l.inside)
+		{
+			l.poly = NewPoly(v);
+		}
+		else
+		{
+			// split vertex, joined by a diagonal to the lowest vertex of the span so far
+			const uint32_t span_id = FindSpan(before);
+			if (span_id != NONE)
+			{
+				auto& span = m_edges[span_id];
+				if (span.merge_poly != NONE)
+				{
+					AddVertex(span.poly, v, SIDE_RIGHT);
+					AddVertex(span.merge_poly, v, SIDE_LEFT);
+					r.poly = span.merge_poly;
+					span.merge_poly = NONE;
+				}
+				else if (span.poly != NONE)
+				{
+					auto& poly = m_polys[span.poly];
+					const uint32_t helper = poly.stack.back();
+					// the piece away from the helper's chain keeps the stack
+					if (poly.side == SIDE_RIGHT)
+					{
+						AddVertex(span.poly, v, SIDE_RIGHT);
+						r.poly = NewPoly(helper);
+						AddVertex(r.poly, v, SIDE_LEFT);
+					}
+					else
+					{
+						const uint32_t poly_id = span.poly;
+						AddVertex(poly_id, v, SIDE_LEFT);
+						r.poly = poly_id;
+						const uint32_t left = NewPoly(helper);
+						AddVertex(left, v, SIDE_RIGHT);
+						span.poly = left;
+					}
+				}
+			}
+		}
+	}
+
+	// after the span, new edges may move m_edges
+	const uint32_t l_id = NewEdge(l);
+	const uint32_t r_id = NewEdge(r);
+	Insert(v, l_id, r_id);
+	CheckCrossing(before, l_id);
+	CheckCrossing(r_id, after);
+}
+
+void Triangulator::EndVertex(uint32_t v, uint32_t prev, uint32_t next)
+{
+	uint32_t a = FindEdge(prev, v);
+	uint32_t b = FindEdge(next, v);
+	if (a == NONE || b == NONE) {
+		m_crossings = true;
+		return;
+	}
+	// next to each other unless edges crossed in between
+	if (Next(a) != b && (Next(b) == a || Rank(a) > Rank(b))) {
+		std::swap(a, b);
+	}
+
+	auto& l = m_edges[a];
+	if (l.boundary)
+	{
+		if (l.inside)
+		{
+			ClosePoly(l.poly, v);
+			ClosePoly(l.merge_poly, v);
+			l.poly = l.merge_poly = NONE;
+		}
+		else
+		{
+			// merge vertex, the spans on both sides become one
+			auto& r = m_edges[b];
+			const uint32_t span_id = FindSpan(Prev(a));
+			if (span_id != NONE)
+			{
+				AddToSpan(m_edges[span_id], v, SIDE_RIGHT);
+				AddToSpan(r, v, SIDE_LEFT);
+				m_edges[span_id].merge_poly = r.poly;
+			}
+			else
+			{
+				ClosePoly(r.poly, v);
+				ClosePoly(r.merge_poly, v);
+			}
+			r.poly = r.merge_poly = NONE;
+		}
+	}
+
+	const uint32_t before = Prev(a);
+	const uint32_t after = Next(b);
+	Erase(b);
+	Erase(a);
+	CheckCrossing(before, after);
+}
+
+void Triangulator::RegularVertex(uint32_t v, uint32_t top, uint32_t bot)
+{
+	const uint32_t id = FindEdge(top, v);
+	if (id == NONE) {
+		m_crossings = true;
+		return;
+	}
+
+	auto& e = m_edges[id];
+	m_segment_edges[Segment(top, v)] = NONE;
+	e.top = v;
+	e.bot = bot;
+	m_segment_edges[Segment(v, bot)] = id;
+	CheckCrossing(Prev(id), id);
+	CheckCrossing(id, Next(id));
+	if (!e.boundary) {
+		return;
+	}
+
+	if (e.inside)
+	{
+		AddToSpan(e, v, SIDE_LEFT);
+	}
+	else
+	{
+		const uint32_t span_id = FindSpan(Prev(id));
+		if (span_id != NONE) {
+			AddToSpan(m_edges[span_id], v, SIDE_RIGHT);
+		}
+	}
+}
+
+Triangulator::Edge Triangulator::MakeEdge(uint32_t top, uint32_t bot, int left_winding, int dir) const
+{
+	Edge e;
+	e.top      = top;
+	e.bot      = bot;
+	e.winding  = left_winding + dir;
+	e.inside   = IsInside(e.winding);
+	e.boundary = e.inside != IsInside(left_winding);
+	e.poly = e.merge_poly = NONE;
+	return e;
+}
+
+void Triangulator::SetContourOutside(const Edge& e, int dir)
+{
+	// going down the normal points right, going up it points left
+	auto& c = m_contours[m_point_contours[e.top]];
+	if (e.boundary) {
+		c.outside = (dir > 0) == e.inside ? -1 : 1;
+	} else {
+		c.outside = 0;
+	}
+}
+
+void Triangulator::AddToSpan(Edge& span, uint32_t v, int side)
+{
+	// v ends the piece on its side of the pending merge and goes on with the other one
+	if (span.merge_poly != NONE)
+	{
+		if (side == SIDE_LEFT)
+		{
+			ClosePoly(span.poly, v);
+			span.poly = span.merge_poly;
+		}
+		else
+		{
+			ClosePoly(span.merge_poly, v);
+		}
+		span.merge_poly = NONE;
+	}
+	AddVertex(span.poly, v, side);
+}
+
+uint32_t Triangulator::NewPoly(uint32_t v)
+{
+	uint32_t id;
+	if (m_free_polys.empty()) {
+		id = static_cast<uint32_t>(m_polys.size());
+		m_polys.push_back(Poly());
+	} else {
+		id = m_free_polys.back();
+		m_free_polys.pop_back();
+	}
+
+	auto& poly = m_polys[id];
+	poly.stack.clear();
+	poly.stack.push_back(v);
+	poly.side = SIDE_NONE;
+	return id;
+}
+
+// the monotone polygon triangulation of de Berg et al., fed one vertex at a time
+void Triangulator::AddVertex(uint32_t id, uint32_t v, int side)
+{
+	if (id == NONE) {
+		return;
+	}
+
+	auto& poly = m_polys[id];
+	auto& stack = poly.stack;
+	if (stack.empty())
+	{
+		stack.push_back(v);
+		return;
+	}
+
+	if (poly.side != side)
+	{
+		// v sees the whole chain on the other side
+		for (size_t i = 0; i + 1 < stack.size(); ++i)
+		{
+			m_indices.push_back(stack[i]);
+			m_indices.push_back(stack[i + 1]);
+			m_indices.push_back(v);
+		}
+		stack[0] = stack.back();
+		stack.resize(1);
+	}
+	else
+	{
+		uint32_t top = stack.back();
+		stack.pop_back();
+		while (!stack.empty())
+		{
+			const float c = cross(m_points[stack.back()], m_points[top], m_points[v]);
+			if (side == SIDE_LEFT ? c >= 0 : c <= 0) {
+				break;
+			}
+			m_indices.push_back(stack.back());
+			m_indices.push_back(top);
+			m_indices.push_back(v);
+			top = stack.back();
+			stack.pop_back();
+		}
+		stack.push_back(top);
+	}
+	stack.push_back(v);
+	poly.side = side;
+}
+
+void Triangulator::ClosePoly(uint32_t id, uint32_t v)
+{
+	if (id == NONE) {
+		return;
+	}
+
+	auto& stack = m_polys[id].stack;
+	for (size_t i = 0; i + 1 < stack.size(); ++i)
+	{
+		m_indices.push_back(stack[i]);
+		m_indices.push_back(stack[i + 1]);
+		m_indices.push_back(v);
+	}
+	stack.clear();
+	m_free_polys.push_back(id);
+}
+
+bool Triangulator::IsInside(int winding) const
+{
+	return m_rule == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+}
+
+}
@@ -0,0 +1,201 @@
+#include "tessellation/VertexCacheOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// the weights of the reference implementation
+const float CACHE_DECAY_POWER   = 1.5f;
+const float LAST_TRI_SCORE      = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// triangles scored around each cached vertex. the others of a fan centre are still
+// reached through their rim vertices, without them a fan costs its valence squared
+const uint32_t MAX_SCORED_TRIS = 32;
+
+}
+
+namespace tess
+{
+
+const size_t VertexCacheOptimizer::CACHE_SIZE;
+
+void VertexCacheOptimizer::Optimize(uint32_t* indices, size_t idx_count, size_t vtx_count)
+{
+	const size_t tri_count = idx_count / 3;
+	if (tri_count < 2) {
+		return;
+	}
+
+	// triangles of each vertex
+	m_valence.resize(vtx_count);
+	std::fill(m_valence.begin(), m_valence.end(), 0);
+	for (size_t i = 0; i < tri_count * 3; ++i) {
+		++m_valence[indices[i]];
+	}
+	m_tri_offsets.resize(vtx_count + 1);
+	m_tri_offsets[0] = 0;
+	for (size_t v = 0; v < vtx_count; ++v) {
+		m_tri_offsets[v + 1] = m_tri_offsets[v] + m_valence[v];
+	}
+	m_vtx_corners.resize(tri_count * 3);
+	m_corner_slots.resize(tri_count * 3);
+	std::fill(m_valence.begin(), m_valence.end(), 0);
+	for (uint32_t i = 0; i < tri_count * 3; ++i)
+	{
+		const uint32_t v = indices[i];
+		const uint32_t slot = m_tri_offsets[v] + m_valence[v]++;
+		m_vtx_corners[slot] = i;
+		m_corner_slots[i]   = slot;
+	}
+
+	m_cache_pos.resize(vtx_count);
+	std::fill(m_cache_pos.begin(), m_cache_pos.end(), -1);
+	m_vtx_score.resize(vtx_count);
+	for (size_t v = 0; v < vtx_count; ++v) {
+		m_vtx_score[v] = CalcVertexScore(static_cast<uint32_t>(v));
+	}
+
+	m_tri_score.resize(tri_count);
+	m_emitted.resize(tri_count);
+	std::fill(m_emitted.begin(), m_emitted.end(), 0);
+	uint32_t best = 0;
+	for (size_t t = 0; t < tri_count; ++t)
+	{
+		auto tri = indices + t * 3;
+		m_tri_score[t] = m_vtx_score[tri[0]] + m_vtx_score[tri[1]] + m_vtx_score[tri[2]];
+		if (m_tri_score[t] > m_tri_score[best]) {
+			best = static_cast<uint32_t>(t);
+		}
+	}
+
+	m_out.resize(tri_count * 3);
+	m_cache.clear();
+	size_t next_unemitted = 0;
+	for (size_t out = 0; out < tri_count; ++out)
+	{
+		// nothing left around the cache, carry on in the input order
+		if (best == NONE)
+		{
+			while (m_emitted[next_unemitted]) {
+				++next_unemitted;
+			}
+			best = static_cast<uint32_t>(next_unemitted);
+		}
+
+		auto tri = indices + best * 3;
+		m_emitted[best] = 1;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			m_out[out * 3 + k] = tri[k];
+			RemoveCorner(best * 3 + static_cast<uint32_t>(k), tri[k]);
+		}
+
+		// the triangle's vertices go to the front, the ones pushed past the end drop out
+		m_next_cache.clear();
+		for (size_t k = 0; k < 3; ++k) {
+			if (std::find(m_next_cache.begin(), m_next_cache.end(), tri[k]) == m_next_cache.end()) {
+				m_next_cache.push_back(tri[k]);
+			}
+		}
+		for (auto v : m_cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				m_next_cache.push_back(v);
+			}
+		}
+		for (size_t i = 0, n = m_next_cache.size(); i < n; ++i)
+		{
+			const uint32_t v = m_next_cache[i];
+			m_cache_pos[v] = i < CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+			m_vtx_score[v] = CalcVertexScore(v);
+		}
+
+		best = NONE;
+		float best_score = -1.0f;
+		for (size_t i = 0, n = m_next_cache.size(); i < n; ++i)
+		{
+			const uint32_t v = m_next_cache[i];
+			for (uint32_t j = m_tri_offsets[v], e = j + std::min(m_valence[v], MAX_SCORED_TRIS); j < e; ++j)
+			{
+				const uint32_t t = m_vtx_corners[j] / 3;
+				auto ti = indices + t * 3;
+				const float score = m_vtx_score[ti[0]] + m_vtx_score[ti[1]] + m_vtx_score[ti[2]];
+				m_tri_score[t] = score;
+				if (i < CACHE_SIZE && score > best_score)
+				{
+					best_score = score;
+					best = t;
+				}
+			}
+		}
+
+		m_cache.resize(std::min(m_next_cache.size(), CACHE_SIZE));
+		std::copy(m_next_cache.begin(), m_next_cache.begin() + m_cache.size(), m_cache.begin());
+	}
+
+	std::copy(m_out.begin(), m_out.end(), indices);
+}
+
+float VertexCacheOptimizer::CalcACMR(const uint32_t* indices, size_t idx_count, size_t vtx_count, size_t cache_size)
+{
+	const size_t tri_count = idx_count / 3;
+	if (tri_count == 0) {
+		return 0;
+	}
+
+	// the miss that brought each vertex in, it stays until cache_size more came after it
+	PodArray<size_t> stamps;
+	stamps.resize(vtx_count);
+	std::fill(stamps.begin(), stamps.end(), 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < tri_count * 3; ++i)
+	{
+		auto& stamp = stamps[indices[i]];
+		if (stamp == 0 || misses - stamp >= cache_size)
+		{
+			++misses;
+			stamp = misses;
+		}
+	}
+	return static_cast<float>(misses) / tri_count;
+}
+
+float VertexCacheOptimizer::CalcVertexScore(uint32_t vertex) const
+{
+	const uint32_t valence = m_valence[vertex];
+	if (valence == 0) {
+		return -1.0f;
+	}
+
+	float score = 0;
+	const int32_t pos = m_cache_pos[vertex];
+	if (pos >= 0)
+	{
+		// the last triangle's vertices score the same, whatever order they came in
+		if (pos < 3) {
+			score = LAST_TRI_SCORE;
+		} else {
+			const float scale = 1.0f / (CACHE_SIZE - 3);
+			score = std::pow(1.0f - (pos - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+	score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(valence), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void VertexCacheOptimizer::RemoveCorner(uint32_t corner, uint32_t vertex)
+{
+	// the last one not emitted takes its slot
+	const uint32_t slot = m_corner_slots[corner];
+	const uint32_t last = m_tri_offsets[vertex] + --m_valence[vertex];
+	const uint32_t moved = m_vtx_corners[last];
+	m_vtx_corners[slot]    = moved;
+	m_vtx_corners[last]    = corner;
+	m_corner_slots[moved]  = slot;
+	m_corner_slots[corner] = last;
+}
+
+}